@@ -3,13 +3,36 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].
+
+   Data moves by bus master DMA when the channels belong to a PCI
+   IDE controller that supports it, such as the PIIX that QEMU
+   emulates, and by PIO otherwise.
+
+   Requests are queued per channel and carried out by an I/O
+   thread for the channel, in C-LOOK order: in increasing order
+   of sector number from the last sector transferred, then
+   wrapping around to the lowest pending sector.  Requests for
+   consecutive sectors of a disk in the same direction are merged
+   into a single command.  A request is never moved ahead of an
+   earlier one that writes any of the same sectors, or that reads
+   any of the sectors it writes.
+
+   Disks attached some other way, such as virtio block devices,
+   have drivers of their own that register them with
+   disk_register().  Such a disk may stand in for one of the ATA
+   positions, so that the rest of the kernel finds it with
+   disk_get() just as it would an ATA disk. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -28,10 +51,42 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, for channels that support DMA.
+   Refer to the PIIX datasheet or [SFF-8038i] for details. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus master command register bits. */
+#define BMC_START 0x01          /* Start transfer. */
+#define BMC_READ 0x08           /* Transfer from disk to memory. */
+
+/* Bus master status register bits. */
+#define BMS_ERR 0x02            /* Transfer failed (write 1 to clear). */
+#define BMS_INTR 0x04           /* Interrupt raised (write 1 to clear). */
+#define BMS_SIMPLEX 0x80        /* Only one channel may use DMA at once. */
+
+/* A physical region descriptor, describing one physically
+   contiguous part of a DMA buffer.  A transfer's descriptors form
+   a table whose address is loaded into the PRD table register.
+   A region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address, word aligned. */
+    uint16_t size;              /* Size in bytes, 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last descriptor. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Number of descriptors in a channel's PRD table.  A transfer
+   that needs more falls back to PIO. */
+#define PRD_CNT 32
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,19 +102,57 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
-
-/* An ATA device. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* 48-bit LBA variants of the commands above, for sectors beyond
+   the reach of 28-bit LBA. */
+#define CMD_READ_SECTORS_EXT 0x24       /* READ SECTOR(S) EXT. */
+#define CMD_READ_DMA_EXT 0x25           /* READ DMA EXT. */
+#define CMD_READ_MULTIPLE_EXT 0x29      /* READ MULTIPLE EXT. */
+#define CMD_WRITE_SECTORS_EXT 0x34      /* WRITE SECTOR(S) EXT. */
+#define CMD_WRITE_DMA_EXT 0x35          /* WRITE DMA EXT. */
+#define CMD_WRITE_MULTIPLE_EXT 0x39     /* WRITE MULTIPLE EXT. */
+
+/* Number of sectors that 28-bit LBA can address. */
+#define LBA28_SECTORS (1UL << 28)
+
+/* Maximum number of sectors transferred by a single READ or WRITE
+   command.  A sector count register value of 0 means 256. */
+#define MAX_COMMAND_SECTORS 256
+
+/* Maximum number of requests merged into a single command. */
+#define MAX_MERGE_REQUESTS 16
+
+/* An ATA device, or a disk registered with disk_register(). */
 struct disk 
   {
     char name[8];               /* Name, e.g. "hd0:1". */
-    struct channel *channel;    /* Channel disk is on. */
+    struct channel *channel;    /* Channel disk is on, if ATA. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
 
     bool is_ata;                /* 1=This device is an ATA disk. */
     disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
-
-    long long read_cnt;         /* Number of sectors read. */
-    long long write_cnt;        /* Number of sectors written. */
+    int multiple;               /* Sectors per interrupt with READ/WRITE
+                                   MULTIPLE, or 0 if not supported. */
+    bool dma;                   /* Transfer data by bus master DMA? */
+    bool lba48;                 /* Supports 48-bit LBA? */
+
+    disk_submit_func *submit;   /* Driver of a registered disk. */
+    void *driver_data;          /* Auxiliary data for SUBMIT. */
+    char alias[8];              /* ATA position of a registered disk, e.g.
+                                   "hd0:1", or "" if none. */
+
+    struct disk_stat stat;      /* Statistics for all kinds of disks. */
+    int queue_depth;            /* Requests submitted but not completed. */
+    disk_sector_t next_sector;  /* Sector after the last one serviced. */
+
+    long long command_cnt;      /* Number of read and write commands. */
+    long long dma_cnt;          /* Number of those that used DMA. */
+    long long merge_cnt;        /* Requests merged into another's command. */
   };
 
 /* An ATA channel (aka controller).
@@ -69,10 +162,23 @@ struct channel
     char name[8];               /* Name, e.g. "hd0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus master base I/O port, 0 if none. */
+    struct prd *prdt;           /* PRD table, if bm_base != 0. */
+
+    struct lock lock;           /* Protects QUEUE, HEAD and NEXT_SEQ. */
+    struct condition queue_ready;       /* Signaled when QUEUE gets a
+                                           request. */
+    struct list queue;          /* Pending requests, ordered by sector. */
+    disk_sector_t head;         /* Sector after the last one transferred. */
+    unsigned next_seq;          /* Sequence number for next request. */
+
+    int64_t busy_ticks;         /* Timer ticks spent transferring. */
+    int64_t busy_since;         /* When the current transfer started. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
-                                   any interrupt would be spurious. */
+                                   any interrupt would be spurious.
+                                   Only the channel's I/O thread accesses
+                                   the controller after initialization. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
     struct disk devices[2];     /* The devices on this channel. */
@@ -82,14 +188,59 @@ struct channel
 #define CHANNEL_CNT 2
 static struct channel channels[CHANNEL_CNT];
 
+/* Disks registered with disk_register(). */
+#define REGISTERED_DISK_CNT 4
+static struct disk registered_disks[REGISTERED_DISK_CNT];
+static size_t registered_disk_cnt;
+
+/* PRD tables, one per channel.  Aligning each table to its own
+   size keeps it from crossing a 64 kB boundary. */
+static struct prd prd_tables[CHANNEL_CNT][PRD_CNT]
+  __attribute__ ((aligned (PRD_CNT * sizeof (struct prd))));
+
+/* Busy time accounting.  Each channel's I/O thread transfers
+   independently of the other's, so that, for example, swap
+   traffic on hd1 overlaps file system traffic on hd0.  These
+   show how much. */
+static int busy_channel_cnt;    /* Channels transferring now. */
+static int64_t all_busy_since;  /* When all channels became busy. */
+static int64_t all_busy_ticks;  /* Ticks with all channels busy. */
+
+static uint16_t find_bus_master (void);
+
+static struct disk *nth_disk (size_t idx);
+static void print_latency_stats (const struct disk *);
+static void begin_service (struct disk_request *, int64_t now);
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
+static void set_multiple_mode (struct disk *, int multiple);
+
+/* A position within a list of requests for consecutive sectors,
+   which lets them be transferred as though their buffers were
+   one. */
+struct cursor
+  {
+    struct list_elem *e;        /* Current request. */
+    size_t ofs;                 /* Sectors of it already passed. */
+  };
+
+static thread_func io_thread NO_RETURN;
+static void take_batch (struct channel *, struct list *batch);
+static void transfer_batch (struct list *batch);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void read_pio (struct disk *, disk_sector_t, struct cursor *,
+                      size_t cnt);
+static void write_pio (struct disk *, disk_sector_t, struct cursor *,
+                       size_t cnt);
+static bool transfer_dma (struct disk *, disk_sector_t, struct cursor *,
+                          size_t cnt, bool read);
+
+static bool select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sector (struct channel *, void *, size_t cnt);
+static void output_sector (struct channel *, const void *, size_t cnt);
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
@@ -102,6 +253,7 @@ static void interrupt_handler (struct intr_frame *);
 void
 disk_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -124,7 +276,16 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
+      c->bm_base = bm_base != 0 ? bm_base + 8 * chan_no : 0;
+      c->prdt = prd_tables[chan_no];
+      if (chan_no > 0 && bm_base != 0 && (inb (bm_base + 2) & BMS_SIMPLEX))
+        c->bm_base = 0;
       lock_init (&c->lock);
+      cond_init (&c->queue_ready);
+      list_init (&c->queue);
+      c->head = 0;
+      c->next_seq = 0;
+      c->busy_ticks = 0;
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -138,8 +299,18 @@ disk_init (void)
 
           d->is_ata = false;
           d->capacity = 0;
-
-          d->read_cnt = d->write_cnt = 0;
+          d->multiple = 0;
+          d->dma = false;
+          d->lba48 = false;
+          d->submit = NULL;
+          d->driver_data = NULL;
+          d->alias[0] = '\0';
+
+          memset (&d->stat, 0, sizeof d->stat);
+          d->queue_depth = 0;
+          d->next_sector = 0;
+
+          d->command_cnt = d->dma_cnt = d->merge_cnt = 0;
         }
 
       /* Register interrupt handler. */
@@ -156,6 +327,13 @@ disk_init (void)
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
           identify_ata_device (&c->devices[dev_no]);
+
+      /* From now on only the I/O thread touches the hardware. */
+      {
+        char name[16];
+        snprintf (name, sizeof name, "%s-io", c->name);
+        thread_create (name, PRI_MAX, io_thread, c);
+      }
     }
 }
 
@@ -163,6 +341,8 @@ disk_init (void)
 void
 disk_print_stats (void) 
 {
+  struct disk *d;
+  size_t i;
   int chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) 
@@ -171,14 +351,168 @@ disk_print_stats (void)
 
       for (dev_no = 0; dev_no < 2; dev_no++) 
         {
-          struct disk *d = disk_get (chan_no, dev_no);
-          if (d != NULL && d->is_ata) 
-            printf ("%s: %lld reads, %lld writes\n",
-                    d->name, d->read_cnt, d->write_cnt);
+          struct disk *d = &channels[chan_no].devices[dev_no];
+          if (d->is_ata) 
+            printf ("%s: %lld reads, %lld writes, %lld commands "
+                    "(%lld DMA), %lld merged requests\n",
+                    d->name, d->stat.read_cnt, d->stat.write_cnt,
+                    d->command_cnt, d->dma_cnt, d->merge_cnt);
         }
+      printf ("%s: busy for %"PRId64" ticks\n",
+              channels[chan_no].name, channels[chan_no].busy_ticks);
+    }
+  printf ("Disk channels: all busy at once for %"PRId64" ticks\n",
+          all_busy_ticks);
+
+  for (i = 0; i < registered_disk_cnt; i++) 
+    {
+      d = &registered_disks[i];
+      printf ("%s: %lld reads, %lld writes", d->name,
+              d->stat.read_cnt, d->stat.write_cnt);
+      if (d->alias[0] != '\0')
+        printf (" in place of %s", d->alias);
+      printf ("\n");
+    }
+
+  for (i = 0; (d = nth_disk (i)) != NULL; i++)
+    print_latency_stats (d);
+}
+
+/* Prints histogram HIST, labeled LABEL, for disk D, omitting
+   empty buckets. */
+static void
+print_histogram (const struct disk *d, const char *label,
+                 const long long hist[DISK_HIST_CNT]) 
+{
+  int i;
+
+  printf ("%s: %s (us):", d->name, label);
+  for (i = 0; i < DISK_HIST_CNT; i++)
+    if (hist[i] != 0) 
+      {
+        if (i < DISK_HIST_CNT - 1)
+          printf (" <%d %lld", 32 << i, hist[i]);
+        else
+          printf (" >=%d %lld", 16 << i, hist[i]);
+      }
+  printf ("\n");
+}
+
+/* Prints request latency, queue depth and attribution statistics
+   for disk D. */
+static void
+print_latency_stats (const struct disk *d) 
+{
+  static const char *user_names[DISK_USER_CNT] =
+    {"other", "swap", "inode", "directory", "free map", "data", "journal"};
+  const struct disk_stat *s = &d->stat;
+  int i;
+
+  if (s->request_cnt == 0)
+    return;
+  printf ("%s: %lld requests, %lld sequential, "
+          "queue depth %lld.%lld average, %d maximum\n",
+          d->name, s->request_cnt, s->sequential_cnt,
+          s->depth_sum / s->request_cnt,
+          s->depth_sum * 10 / s->request_cnt % 10, s->max_depth);
+  printf ("%s: %lld us average wait, %lld us average service\n",
+          d->name, s->wait_usecs / s->request_cnt,
+          s->service_usecs / s->request_cnt);
+  print_histogram (d, "wait", s->wait_hist);
+  print_histogram (d, "service", s->service_hist);
+  for (i = 0; i < DISK_USER_CNT; i++) 
+    {
+      const struct disk_user_stat *u = &s->users[i];
+      if (u->request_cnt != 0)
+        printf ("%s: %s: %lld requests, %lld sectors, %lld us\n",
+                d->name, user_names[i], u->request_cnt, u->sector_cnt,
+                u->usecs);
     }
 }
 
+/* Returns the IDX'th disk, counting the ATA disks that are
+   present and then the registered disks, or a null pointer if
+   there are fewer than IDX + 1 disks. */
+static struct disk *
+nth_disk (size_t idx) 
+{
+  int chan_no, dev_no;
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    for (dev_no = 0; dev_no < 2; dev_no++)
+      if (channels[chan_no].devices[dev_no].is_ata && idx-- == 0)
+        return &channels[chan_no].devices[dev_no];
+  return idx < registered_disk_cnt ? &registered_disks[idx] : NULL;
+}
+
+/* Copies the statistics for the IDX'th disk, counting as
+   nth_disk() does, into *STAT.  Returns true if successful,
+   false if there is no such disk. */
+bool
+disk_get_stat (size_t idx, struct disk_stat *stat) 
+{
+  struct disk *d = nth_disk (idx);
+  enum intr_level old_level;
+
+  if (d == NULL)
+    return false;
+
+  old_level = intr_disable ();
+  *stat = d->stat;
+  intr_set_level (old_level);
+  strlcpy (stat->name, d->name, sizeof stat->name);
+  stat->capacity = d->capacity;
+  return true;
+}
+
+/* Sets the user to which the running thread's disk requests are
+   attributed to USER, and returns the previous one. */
+enum disk_user
+disk_set_user (enum disk_user user) 
+{
+  struct thread *t = thread_current ();
+  enum disk_user old = t->disk_user;
+
+  ASSERT (user < DISK_USER_CNT);
+
+  t->disk_user = user;
+  return old;
+}
+
+/* Registers a disk named NAME, e.g. "vda", with CAPACITY sectors,
+   whose driver carries out requests to it when the generic disk
+   layer passes them to SUBMIT along with DRIVER_DATA.  SUBMIT
+   must not sleep for long.  The driver must call disk_complete()
+   when each request completes.
+
+   If ALIAS is nonnull, it names the ATA position, e.g. "hd0:1",
+   that the disk stands in for: from now on, disk_get() returns
+   the new disk for that position instead of any ATA disk there.
+
+   Returns the new disk. */
+struct disk *
+disk_register (const char *name, const char *alias, disk_sector_t capacity,
+               disk_submit_func *submit, void *driver_data) 
+{
+  struct disk *d;
+
+  ASSERT (name != NULL);
+  ASSERT (submit != NULL);
+
+  if (registered_disk_cnt >= REGISTERED_DISK_CNT)
+    PANIC ("%s: too many registered disks", name);
+  d = &registered_disks[registered_disk_cnt++];
+  strlcpy (d->name, name, sizeof d->name);
+  strlcpy (d->alias, alias != NULL ? alias : "", sizeof d->alias);
+  d->channel = NULL;
+  d->dev_no = 0;
+  d->is_ata = false;
+  d->capacity = capacity;
+  d->submit = submit;
+  d->driver_data = driver_data;
+  return d;
+}
+
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
    slave, respectively--within the channel numbered CHAN_NO.
 
@@ -187,12 +521,23 @@ disk_print_stats (void)
         0:1 - file system
         1:0 - scratch
         1:1 - swap
+
+   A registered disk that stands in for the requested position
+   takes precedence over an ATA disk there.
 */
 struct disk *
 disk_get (int chan_no, int dev_no) 
 {
+  char alias[8];
+  size_t i;
+
   ASSERT (dev_no == 0 || dev_no == 1);
 
+  snprintf (alias, sizeof alias, "hd%d:%d", chan_no, dev_no);
+  for (i = 0; i < registered_disk_cnt; i++)
+    if (!strcmp (registered_disks[i].alias, alias))
+      return &registered_disks[i];
+
   if (chan_no < (int) CHANNEL_CNT) 
     {
       struct disk *d = &channels[chan_no].devices[dev_no];
@@ -219,21 +564,7 @@ disk_size (struct disk *d)
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
 {
-  struct channel *c;
-  
-  ASSERT (d != NULL);
-  ASSERT (buffer != NULL);
-
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  d->read_cnt++;
-  lock_release (&c->lock);
+  disk_read_multiple (d, sec_no, buffer, 1);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -244,25 +575,428 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
+  disk_write_multiple (d, sec_no, buffer, 1);
+}
+
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, void *buffer,
+                    size_t cnt) 
+{
+  struct disk_request r;
+
+  disk_submit (&r, d, sec_no, buffer, cnt, false, NULL, NULL);
+  disk_wait (&r);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no,
+                     const void *buffer, size_t cnt)
+{
+  struct disk_request r;
+
+  disk_submit (&r, d, sec_no, (void *) buffer, cnt, true, NULL, NULL);
+  disk_wait (&r);
+}
+
+/* Returns true if request A's first sector precedes B's. */
+static bool
+request_less (const struct list_elem *a_, const struct list_elem *b_,
+              void *aux UNUSED) 
+{
+  const struct disk_request *a = list_entry (a_, struct disk_request, elem);
+  const struct disk_request *b = list_entry (b_, struct disk_request, elem);
+
+  return a->sec_no < b->sec_no;
+}
+
+/* Starts reading (if WRITE is false) or writing (if WRITE is
+   true) CNT consecutive sectors starting at SEC_NO on disk D,
+   into or from BUFFER, which must have room for CNT *
+   DISK_SECTOR_SIZE bytes, and returns without waiting for the
+   transfer.  R describes the request until it completes; R and
+   BUFFER must remain valid until then.
+
+   When the request completes, FUNC, if nonnull, is called with
+   R and AUX in the context of the disk's I/O thread, or for a
+   registered disk possibly in an interrupt handler; it must not
+   sleep, since it holds up other requests.  If FUNC is null, the
+   caller must instead call disk_wait() on R. */
+void
+disk_submit (struct disk_request *r, struct disk *d, disk_sector_t sec_no,
+             void *buffer, size_t cnt, bool write,
+             disk_request_func *func, void *aux) 
+{
+  enum intr_level old_level;
   struct channel *c;
-  
+
+  ASSERT (r != NULL);
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
+  ASSERT (cnt > 0);
+  ASSERT (sec_no < d->capacity && cnt <= d->capacity - sec_no);
+
+  r->disk = d;
+  r->sec_no = sec_no;
+  r->buffer = buffer;
+  r->cnt = cnt;
+  r->write = write;
+  r->func = func;
+  r->aux = aux;
+  sema_init (&r->done, 0);
+  r->user = thread_current ()->disk_user;
+
+  old_level = intr_disable ();
+  r->submit_time = timer_usecs ();
+  d->stat.depth_sum += ++d->queue_depth;
+  if (d->queue_depth > d->stat.max_depth)
+    d->stat.max_depth = d->queue_depth;
+  intr_set_level (old_level);
+
+  /* A registered disk's driver starts carrying out the request
+     right away, as far as we can tell. */
+  if (d->submit != NULL) 
+    {
+      begin_service (r, r->submit_time);
+      d->submit (d->driver_data, r);
+      return;
+    }
 
   c = d->channel;
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  d->write_cnt++;
+  r->seq = c->next_seq++;
+  list_insert_ordered (&c->queue, &r->elem, request_less, NULL);
+  cond_signal (&c->queue_ready, &c->lock);
   lock_release (&c->lock);
 }
-
+
+/* Waits for request R, submitted without a completion function,
+   to complete. */
+void
+disk_wait (struct disk_request *r) 
+{
+  ASSERT (r->func == NULL);
+
+  sema_down (&r->done);
+}
+
+/* Returns the histogram bucket for a latency of USECS
+   microseconds. */
+static int
+hist_bucket (int64_t usecs) 
+{
+  int i;
+
+  for (i = 0; i < DISK_HIST_CNT - 1 && usecs >= (32 << i); i++)
+    continue;
+  return i;
+}
+
+/* Records that the disk started carrying out request R at time
+   NOW, as returned by timer_usecs(). */
+static void
+begin_service (struct disk_request *r, int64_t now) 
+{
+  struct disk *d = r->disk;
+  enum intr_level old_level = intr_disable ();
+
+  r->start_time = now;
+  if (r->sec_no == d->next_sector)
+    d->stat.sequential_cnt++;
+  d->next_sector = r->sec_no + r->cnt;
+  intr_set_level (old_level);
+}
+
+/* Records that request R has completed and notifies its
+   submitter.  Called by the ATA I/O threads, and by the drivers
+   of registered disks, possibly from an interrupt handler. */
+void
+disk_complete (struct disk_request *r) 
+{
+  struct disk_stat *s = &r->disk->stat;
+  struct disk_user_stat *u = &s->users[r->user];
+  enum intr_level old_level = intr_disable ();
+  int64_t now = timer_usecs ();
+  int64_t wait = r->start_time - r->submit_time;
+  int64_t service = now - r->start_time;
+
+  r->disk->queue_depth--;
+  if (r->write)
+    s->write_cnt += r->cnt;
+  else
+    s->read_cnt += r->cnt;
+  s->request_cnt++;
+  s->wait_usecs += wait;
+  s->service_usecs += service;
+  s->wait_hist[hist_bucket (wait)]++;
+  s->service_hist[hist_bucket (service)]++;
+  u->request_cnt++;
+  u->sector_cnt += r->cnt;
+  u->usecs += wait + service;
+  intr_set_level (old_level);
+
+  if (r->func != NULL)
+    r->func (r, r->aux);
+  else
+    sema_up (&r->done);
+}
+
+/* Returns true if carrying out A and B in either order could
+   give different results. */
+static bool
+requests_conflict (const struct disk_request *a,
+                   const struct disk_request *b) 
+{
+  return (a->disk == b->disk
+          && (a->write || b->write)
+          && a->sec_no < b->sec_no + b->cnt
+          && b->sec_no < a->sec_no + a->cnt);
+}
+
+/* Returns the earliest submitted request in C's queue that was
+   submitted before R and conflicts with it, or a null pointer if
+   there is none.  The caller must hold C's lock. */
+static struct disk_request *
+earliest_conflict (struct channel *c, const struct disk_request *r) 
+{
+  struct disk_request *earliest = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e)) 
+    {
+      struct disk_request *q = list_entry (e, struct disk_request, elem);
+      if ((int) (q->seq - r->seq) < 0 && requests_conflict (q, r)
+          && (earliest == NULL || (int) (q->seq - earliest->seq) < 0))
+        earliest = q;
+    }
+  return earliest;
+}
+
+/* Moves the requests that channel C's I/O thread should carry out
+   next from C's queue to BATCH: the next request in C-LOOK order,
+   followed by any requests for the sectors right after it that
+   can share its command.  The caller must hold C's lock, and C's
+   queue must not be empty. */
+static void
+take_batch (struct channel *c, struct list *batch) 
+{
+  struct disk_request *first, *conflict;
+  struct list_elem *e;
+  disk_sector_t end;
+  size_t cnt, merged;
+
+  ASSERT (!list_empty (&c->queue));
+
+  /* The first request at or after the head, or if none, the first
+     request of all. */
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    if (list_entry (e, struct disk_request, elem)->sec_no >= c->head)
+      break;
+  if (e == list_end (&c->queue))
+    e = list_begin (&c->queue);
+  first = list_entry (e, struct disk_request, elem);
+
+  /* Never overtake an earlier conflicting request. */
+  while ((conflict = earliest_conflict (c, first)) != NULL)
+    first = conflict;
+
+  e = list_remove (&first->elem);
+  list_push_back (batch, &first->elem);
+  end = first->sec_no + first->cnt;
+  cnt = first->cnt;
+
+  /* Merge requests that continue where the batch ends.  The queue
+     is sorted, so they can only be among the requests that start
+     at or before END. */
+  for (merged = 0; e != list_end (&c->queue) && merged < MAX_MERGE_REQUESTS;)
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+
+      if (r->sec_no > end)
+        break;
+      if (r->disk == first->disk && r->write == first->write
+          && r->sec_no == end && cnt + r->cnt <= MAX_COMMAND_SECTORS
+          && earliest_conflict (c, r) == NULL) 
+        {
+          e = list_remove (&r->elem);
+          list_push_back (batch, &r->elem);
+          end += r->cnt;
+          cnt += r->cnt;
+          merged++;
+        }
+      else
+        e = list_next (e);
+    }
+  first->disk->merge_cnt += merged;
+  c->head = end;
+}
+
+/* Records that channel C has started (if BUSY is true) or
+   finished (if BUSY is false) a transfer.
+
+   Time is measured in whole timer ticks, but a transfer is as
+   likely to start at any point within a tick as another, so the
+   totals are accurate on average even for transfers much shorter
+   than a tick. */
+static void
+account_busy (struct channel *c, bool busy) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t now = timer_ticks ();
+
+  if (busy) 
+    {
+      c->busy_since = now;
+      if (++busy_channel_cnt == CHANNEL_CNT)
+        all_busy_since = now;
+    }
+  else 
+    {
+      c->busy_ticks += now - c->busy_since;
+      if (busy_channel_cnt-- == CHANNEL_CNT)
+        all_busy_ticks += now - all_busy_since;
+    }
+  intr_set_level (old_level);
+}
+
+/* A channel's I/O thread, which carries out the requests in
+   channel C_'s queue one batch at a time. */
+static void
+io_thread (void *c_) 
+{
+  struct channel *c = c_;
+
+  for (;;) 
+    {
+      struct list batch;
+      struct list_elem *e;
+      int64_t now;
+
+      list_init (&batch);
+      lock_acquire (&c->lock);
+      while (list_empty (&c->queue))
+        cond_wait (&c->queue_ready, &c->lock);
+      take_batch (c, &batch);
+      lock_release (&c->lock);
+
+      now = timer_usecs ();
+      for (e = list_begin (&batch); e != list_end (&batch); e = list_next (e))
+        begin_service (list_entry (e, struct disk_request, elem), now);
+
+      account_busy (c, true);
+      transfer_batch (&batch);
+      account_busy (c, false);
+
+      while (!list_empty (&batch)) 
+        {
+          struct disk_request *r = list_entry (list_pop_front (&batch),
+                                               struct disk_request, elem);
+          disk_complete (r);
+        }
+    }
+}
+
+/* Returns the address of the data at CUR, then advances CUR by
+   *CNT sectors or to the end of its current request, whichever
+   comes first, and sets *CNT to the number of sectors passed. */
+static uint8_t *
+cursor_advance (struct cursor *cur, size_t *cnt) 
+{
+  struct disk_request *r = list_entry (cur->e, struct disk_request, elem);
+  uint8_t *p = (uint8_t *) r->buffer + cur->ofs * DISK_SECTOR_SIZE;
+
+  if (*cnt > r->cnt - cur->ofs)
+    *cnt = r->cnt - cur->ofs;
+  cur->ofs += *cnt;
+  if (cur->ofs == r->cnt) 
+    {
+      cur->e = list_next (cur->e);
+      cur->ofs = 0;
+    }
+  return p;
+}
+
+/* Carries out BATCH, a list of requests for consecutive sectors
+   of one disk in the same direction, using one command per
+   MAX_COMMAND_SECTORS sectors, by DMA if possible and otherwise
+   by PIO.  Must be called only by the disk's I/O thread. */
+static void
+transfer_batch (struct list *batch) 
+{
+  struct disk_request *first = list_entry (list_front (batch),
+                                           struct disk_request, elem);
+  struct disk *d = first->disk;
+  disk_sector_t sec_no = first->sec_no;
+  struct cursor cur;
+  size_t cnt = 0;
+  struct list_elem *e;
+
+  for (e = list_begin (batch); e != list_end (batch); e = list_next (e))
+    cnt += list_entry (e, struct disk_request, elem)->cnt;
+
+  cur.e = list_begin (batch);
+  cur.ofs = 0;
+  while (cnt > 0) 
+    {
+      size_t cmd_cnt = cnt < MAX_COMMAND_SECTORS ? cnt : MAX_COMMAND_SECTORS;
+
+      if (transfer_dma (d, sec_no, &cur, cmd_cnt, !first->write))
+        d->dma_cnt++;
+      else if (first->write)
+        write_pio (d, sec_no, &cur, cmd_cnt);
+      else
+        read_pio (d, sec_no, &cur, cmd_cnt);
+      d->command_cnt++;
+
+      sec_no += cmd_cnt;
+      cnt -= cmd_cnt;
+    }
+}
+
 /* Disk detection and identification. */
 
+/* Looks for a PCI IDE controller that can act as a bus master
+   for the legacy channels.  If there is one, enables bus
+   mastering and returns its bus master base I/O port, whose
+   first 8 ports control channel 0 and next 8 channel 1.
+   Otherwise, returns 0. */
+static uint16_t
+find_bus_master (void) 
+{
+  struct pci_address a;
+  int i;
+
+  for (i = 0; pci_find_class (0x01, 0x01, i, &a); i++) 
+    {
+      uint8_t prog_if = pci_read_config (a, PCI_REG_CLASS) >> 8;
+      uint32_t bar = pci_read_config (a, PCI_REG_BAR0 + 4 * 4);
+      uint32_t command;
+
+      /* Programming interface bit 7 means bus master capable.
+         Bits 0 and 2 mean that channel 0 or 1, respectively, is
+         not at its legacy ports, which is all we support. */
+      if ((prog_if & 0x85) != 0x80 || !(bar & PCI_BAR_IO))
+        continue;
+
+      command = pci_read_config (a, PCI_REG_COMMAND) & 0xffff;
+      pci_write_config (a, PCI_REG_COMMAND,
+                        command | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+      return bar & PCI_BAR_IO_MASK;
+    }
+  return 0;
+}
+
 static void print_ata_string (char *string, size_t size);
 
 /* Resets an ATA channel and waits for any devices present on it
@@ -381,10 +1115,30 @@ identify_ata_device (struct disk *d)
       d->is_ata = false;
       return;
     }
-  input_sector (c, id);
+  input_sector (c, id, 1);
 
-  /* Calculate capacity. */
+  /* Calculate capacity.  Words 60-61 give the number of sectors
+     that 28-bit LBA can address.  A disk that supports 48-bit LBA,
+     as bit 10 of word 83 says, gives its full capacity in words
+     100-103; disk_sector_t only reaches 2 TB of that. */
   d->capacity = id[60] | ((uint32_t) id[61] << 16);
+  d->lba48 = (id[83] & 0x400) != 0;
+  if (d->lba48) 
+    {
+      if (id[102] != 0 || id[103] != 0)
+        d->capacity = UINT32_MAX;
+      else
+        d->capacity = id[100] | ((uint32_t) id[101] << 16);
+    }
+
+  /* Transfer as many sectors per interrupt as the disk allows.
+     Bits 7:0 of word 47 give the maximum for READ/WRITE MULTIPLE,
+     or 0 if the disk does not support them. */
+  set_multiple_mode (d, id[47] & 0xff);
+
+  /* Use DMA if the channel supports it and, according to bit 8
+     of word 49, so does the disk. */
+  d->dma = c->bm_base != 0 && (id[49] & 0x100) != 0;
 
   /* Print identification message. */
   printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
@@ -404,6 +1158,29 @@ identify_ata_device (struct disk *d)
   printf ("\"\n");
 }
 
+/* Enables READ/WRITE MULTIPLE on disk D with blocks of up to
+   MULTIPLE sectors, rounded down to a power of 2 as some devices
+   require.  If MULTIPLE is 0 or the disk rejects the command,
+   leaves D transferring one sector per interrupt. */
+static void
+set_multiple_mode (struct disk *d, int multiple) 
+{
+  struct channel *c = d->channel;
+
+  while (multiple & (multiple - 1))
+    multiple &= multiple - 1;
+  if (multiple <= 1)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), multiple);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_status (c)) & STA_ERR) == 0)
+    d->multiple = multiple;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -425,24 +1202,234 @@ print_ata_string (char *string, size_t size)
     printf ("%c", string[i ^ 1]);
 }
 
-/* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+/* Returns the number of sectors transferred per interrupt to or
+   from disk D in PIO mode. */
+static size_t
+block_sectors (const struct disk *d) 
+{
+  return d->multiple > 0 ? (size_t) d->multiple : 1;
+}
+
+/* Reads CNT sectors, at most MAX_COMMAND_SECTORS, starting at
+   SEC_NO from disk D in PIO mode into the buffers at CUR, and
+   advances CUR past them.  If the disk supports READ MULTIPLE,
+   takes one interrupt per block of sectors rather than one per
+   sector. */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) 
+read_pio (struct disk *d, disk_sector_t sec_no, struct cursor *cur,
+          size_t cnt) 
 {
   struct channel *c = d->channel;
+  size_t i;
 
-  ASSERT (sec_no < d->capacity);
-  ASSERT (sec_no < (1UL << 28));
+  if (!select_sector (d, sec_no, cnt))
+    issue_pio_command (c, d->multiple > 0 ? CMD_READ_MULTIPLE
+                                          : CMD_READ_SECTOR_RETRY);
+  else
+    issue_pio_command (c, d->multiple > 0 ? CMD_READ_MULTIPLE_EXT
+                                          : CMD_READ_SECTORS_EXT);
+  for (i = 0; i < cnt; i += block_sectors (d)) 
+    {
+      size_t block_cnt = cnt - i;
+      if (block_cnt > block_sectors (d))
+        block_cnt = block_sectors (d);
+
+      sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no + i);
+      while (block_cnt > 0) 
+        {
+          size_t n = block_cnt;
+          void *p = cursor_advance (cur, &n);
+          input_sector (c, p, n);
+          block_cnt -= n;
+        }
+    }
+}
+
+/* Writes CNT sectors, at most MAX_COMMAND_SECTORS, starting at
+   SEC_NO to disk D in PIO mode from the buffers at CUR, and
+   advances CUR past them.  If the disk supports WRITE MULTIPLE,
+   takes one interrupt per block of sectors rather than one per
+   sector. */
+static void
+write_pio (struct disk *d, disk_sector_t sec_no, struct cursor *cur,
+           size_t cnt) 
+{
+  struct channel *c = d->channel;
+  size_t i;
+
+  if (!select_sector (d, sec_no, cnt))
+    issue_pio_command (c, d->multiple > 0 ? CMD_WRITE_MULTIPLE
+                                          : CMD_WRITE_SECTOR_RETRY);
+  else
+    issue_pio_command (c, d->multiple > 0 ? CMD_WRITE_MULTIPLE_EXT
+                                          : CMD_WRITE_SECTORS_EXT);
+  for (i = 0; i < cnt; i += block_sectors (d)) 
+    {
+      size_t block_cnt = cnt - i;
+      if (block_cnt > block_sectors (d))
+        block_cnt = block_sectors (d);
+
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no + i);
+      while (block_cnt > 0) 
+        {
+          size_t n = block_cnt;
+          const void *p = cursor_advance (cur, &n);
+          output_sector (c, p, n);
+          block_cnt -= n;
+        }
+      sema_down (&c->completion_wait);
+    }
+}
+
+/* Fills in channel C's PRD table to describe the buffers for the
+   CNT sectors at CUR.  Returns false if a buffer cannot be the
+   target of DMA, because it is not in the kernel's mapping of
+   physical memory or is not word aligned, or if the buffers need
+   more than PRD_CNT descriptors. */
+static bool
+build_prdt (struct channel *c, struct cursor cur, size_t cnt) 
+{
+  struct prd *prd = c->prdt;
+
+  while (cnt > 0) 
+    {
+      size_t n = cnt;
+      void *p = cursor_advance (&cur, &n);
+      uintptr_t phys;
+      size_t size;
+
+      if (!is_kernel_vaddr (p) || (uintptr_t) p % 2 != 0)
+        return false;
+      phys = vtop (p);
+      for (size = n * DISK_SECTOR_SIZE; size > 0; prd++) 
+        {
+          /* Stop each region at the next 64 kB boundary. */
+          size_t region = 0x10000 - phys % 0x10000;
+          if (region > size)
+            region = size;
+
+          if (prd >= c->prdt + PRD_CNT)
+            return false;
+          prd->addr = phys;
+          prd->size = region & 0xffff;
+          prd->flags = 0;
+
+          phys += region;
+          size -= region;
+        }
+      cnt -= n;
+    }
+  prd[-1].flags = PRD_EOT;
+  return true;
+}
+
+/* Transfers CNT sectors, at most MAX_COMMAND_SECTORS, starting at
+   SEC_NO between disk D and the buffers at CUR by bus master DMA,
+   from the disk into the buffers if READ is true, otherwise the
+   reverse, and advances CUR past them.  The CPU is free to run
+   other threads until the completion interrupt.  Returns false,
+   without transferring anything or advancing CUR, if D does not
+   use DMA or the buffers are unsuitable for it.  If the transfer
+   fails, stops using DMA on D and returns false, so that the
+   caller falls back to PIO. */
+static bool
+transfer_dma (struct disk *d, disk_sector_t sec_no, struct cursor *cur,
+              size_t cnt, bool read) 
+{
+  struct channel *c = d->channel;
+  uint8_t direction = read ? BMC_READ : 0;
+  uint8_t bm_status, status;
+  size_t left;
+
+  if (!d->dma || !build_prdt (c, *cur, cnt))
+    return false;
+
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), direction);
+  outb (reg_bm_status (c), inb (reg_bm_status (c)) | BMS_ERR | BMS_INTR);
+
+  if (!select_sector (d, sec_no, cnt))
+    issue_pio_command (c, read ? CMD_READ_DMA : CMD_WRITE_DMA);
+  else
+    issue_pio_command (c, read ? CMD_READ_DMA_EXT : CMD_WRITE_DMA_EXT);
+  outb (reg_bm_command (c), direction | BMC_START);
+  sema_down (&c->completion_wait);
+  outb (reg_bm_command (c), direction);
+
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), bm_status | BMS_ERR | BMS_INTR);
+
+  /* wait_while_busy() returns false both when the disk is done
+     and when it times out still busy, so check BSY here too. */
+  wait_while_busy (d);
+  status = inb (reg_status (c));
+  if ((status & (STA_BSY | STA_DRQ | STA_ERR)) != 0
+      || (bm_status & BMS_ERR) != 0) 
+    {
+      printf ("%s: DMA %s failed, sector=%"PRDSNu"; using PIO\n",
+              d->name, read ? "read" : "write", sec_no);
+      d->dma = false;
+      return false;
+    }
+
+  for (left = cnt; left > 0; ) 
+    {
+      size_t n = left;
+      cursor_advance (cur, &n);
+      left -= n;
+    }
+  return true;
+}
+
+/* Selects device D, waiting for it to become ready, and then
+   writes SEC_NO to the disk's sector selection registers and CNT,
+   which must be between 1 and MAX_COMMAND_SECTORS, to its sector
+   count register.  (We use LBA mode.)
+
+   Uses 28-bit LBA if it reaches all of the sectors, and returns
+   false.  Otherwise, uses 48-bit LBA, which D must support, and
+   returns true; the caller must then issue the EXT form of its
+   command.  For 48-bit LBA, each register is a two-byte FIFO,
+   written high-order byte first. */
+static bool
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) 
+{
+  struct channel *c = d->channel;
+  bool lba48 = (uint64_t) sec_no + cnt > LBA28_SECTORS;
+
+  ASSERT (cnt >= 1 && cnt <= MAX_COMMAND_SECTORS);
+  ASSERT (sec_no < d->capacity && cnt <= d->capacity - sec_no);
+  ASSERT (!lba48 || d->lba48);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
-  outb (reg_lbal (c), sec_no);
-  outb (reg_lbam (c), sec_no >> 8);
-  outb (reg_lbah (c), (sec_no >> 16));
-  outb (reg_device (c),
-        DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
+  if (lba48) 
+    {
+      /* disk_sector_t has only 32 bits, so LBA 47:32 are 0. */
+      outb (reg_nsect (c), cnt >> 8);
+      outb (reg_lbal (c), sec_no >> 24);
+      outb (reg_lbam (c), 0);
+      outb (reg_lbah (c), 0);
+      outb (reg_nsect (c), cnt);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), sec_no >> 16);
+      outb (reg_device (c),
+            DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0));
+    }
+  else 
+    {
+      outb (reg_nsect (c), cnt == MAX_COMMAND_SECTORS ? 0 : cnt);
+      outb (reg_lbal (c), sec_no);
+      outb (reg_lbam (c), sec_no >> 8);
+      outb (reg_lbah (c), (sec_no >> 16));
+      outb (reg_device (c), (DEV_MBS | DEV_LBA
+                             | (d->dev_no == 1 ? DEV_DEV : 0)
+                             | (sec_no >> 24)));
+    }
+  return lba48;
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
@@ -458,20 +1445,21 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTOR, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) 
+input_sector (struct channel *c, void *sector, size_t cnt) 
 {
-  insw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+  insw (reg_data (c), sector, cnt * DISK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain DISK_SECTOR_SIZE bytes. */
+/* Writes CNT sectors from SECTOR to channel C's data register in
+   PIO mode.  SECTOR must contain CNT * DISK_SECTOR_SIZE bytes. */
 static void
-output_sector (struct channel *c, const void *sector) 
+output_sector (struct channel *c, const void *sector, size_t cnt) 
 {
-  outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+  outsw (reg_data (c), sector, cnt * DISK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
@@ -1,8 +1,13 @@
 #ifndef DEVICES_DISK_H
 #define DEVICES_DISK_H
 
+#include <diskstat.h>
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -15,12 +20,56 @@ typedef uint32_t disk_sector_t;
    printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+struct disk_request;
+
+/* Called when request R completes, with the AUX passed to
+   disk_submit(). */
+typedef void disk_request_func (struct disk_request *r, void *aux);
+
+/* An asynchronous request to read or write consecutive sectors.
+   Allocated by the caller and filled in by disk_submit(); the
+   members are otherwise private to the disk driver. */
+struct disk_request
+  {
+    struct list_elem elem;      /* Element in a channel's queue. */
+    struct disk *disk;          /* Disk to access. */
+    disk_sector_t sec_no;       /* First sector. */
+    void *buffer;               /* Data to read or write. */
+    size_t cnt;                 /* Number of sectors. */
+    bool write;                 /* Write (true) or read (false)? */
+    unsigned seq;               /* Order of submission. */
+    enum disk_user user;        /* User charged for the request. */
+    int64_t submit_time;        /* When submitted, in microseconds. */
+    int64_t start_time;         /* When the disk started on it. */
+    disk_request_func *func;    /* Completion function, or NULL. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    struct semaphore done;      /* Up'd on completion if FUNC is NULL. */
+  };
+
 void disk_init (void);
 void disk_print_stats (void);
+bool disk_get_stat (size_t idx, struct disk_stat *);
+enum disk_user disk_set_user (enum disk_user);
 
 struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, void *, size_t);
+void disk_write_multiple (struct disk *, disk_sector_t, const void *,
+                          size_t);
+
+void disk_submit (struct disk_request *, struct disk *, disk_sector_t,
+                  void *, size_t, bool write, disk_request_func *, void *);
+void disk_wait (struct disk_request *);
+
+/* Carries out request R on a registered disk, given the
+   DRIVER_DATA passed to disk_register(). */
+typedef void disk_submit_func (void *driver_data, struct disk_request *r);
+
+struct disk *disk_register (const char *name, const char *alias,
+                            disk_sector_t capacity, disk_submit_func *,
+                            void *driver_data);
+void disk_complete (struct disk_request *);
 
 #endif /* devices/disk.h */
@@ -0,0 +1,133 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+
+/* The code in this file reads and writes PCI configuration space
+   using configuration mechanism #1, which is what every PC
+   chipset (and every emulator) that Pintos runs on implements. */
+
+/* Configuration mechanism #1 ports. */
+#define CONFIG_ADDRESS 0xcf8    /* Selects a function and register. */
+#define CONFIG_DATA 0xcfc       /* Reads or writes the selected register. */
+
+/* Returns the CONFIG_ADDRESS value that selects register REG of
+   the function at A. */
+static uint32_t
+config_address (struct pci_address a, uint8_t reg) 
+{
+  return (0x80000000 | ((uint32_t) a.bus << 16) | ((uint32_t) a.dev << 11)
+          | ((uint32_t) a.func << 8) | (reg & 0xfc));
+}
+
+/* Returns the 32-bit configuration register at offset REG, which
+   must be a multiple of 4, of the function at A. */
+uint32_t
+pci_read_config (struct pci_address a, uint8_t reg) 
+{
+  enum intr_level old_level;
+  uint32_t value;
+
+  ASSERT (reg % 4 == 0);
+
+  old_level = intr_disable ();
+  outl (CONFIG_ADDRESS, config_address (a, reg));
+  value = inl (CONFIG_DATA);
+  intr_set_level (old_level);
+
+  return value;
+}
+
+/* Writes VALUE to the 32-bit configuration register at offset
+   REG, which must be a multiple of 4, of the function at A. */
+void
+pci_write_config (struct pci_address a, uint8_t reg, uint32_t value) 
+{
+  enum intr_level old_level;
+
+  ASSERT (reg % 4 == 0);
+
+  old_level = intr_disable ();
+  outl (CONFIG_ADDRESS, config_address (a, reg));
+  outl (CONFIG_DATA, value);
+  intr_set_level (old_level);
+}
+
+/* Returns true if a function whose ID register is ID and whose
+   class register is CLASS matches AUX. */
+typedef bool match_func (uint32_t id, uint32_t class, uint32_t aux);
+
+/* Finds the INDEX'th function, counting from 0, for which MATCH
+   returns true, and stores its address into *A.  Returns true if
+   successful, false if there are not that many. */
+static bool
+find (match_func *match, uint32_t aux, int index, struct pci_address *a) 
+{
+  unsigned bus, dev, func;
+
+  for (bus = 0; bus < 256; bus++)
+    for (dev = 0; dev < 32; dev++)
+      for (func = 0; func < 8; func++) 
+        {
+          struct pci_address try = {bus, dev, func};
+          uint32_t id = pci_read_config (try, PCI_REG_ID);
+
+          if ((id & 0xffff) == 0xffff)
+            {
+              /* No function here, and if there is no function 0,
+                 there are no others in the device either. */
+              if (func == 0)
+                break;
+              continue;
+            }
+          if (match (id, pci_read_config (try, PCI_REG_CLASS), aux)
+              && index-- == 0)
+            {
+              *a = try;
+              return true;
+            }
+
+          /* Only multifunction devices have functions past 0. */
+          if (func == 0
+              && !(pci_read_config (try, PCI_REG_HEADER) & 0x00800000))
+            break;
+        }
+  return false;
+}
+
+/* Matches functions whose class and subclass codes equal the two
+   low bytes of AUX. */
+static bool
+match_class (uint32_t id UNUSED, uint32_t class, uint32_t aux) 
+{
+  return (class >> 16) == aux;
+}
+
+/* Finds the INDEX'th PCI function, counting from 0, with the
+   given CLASS and SUBCLASS codes, and stores its address into
+   *A.  Returns true if successful, false if there are not that
+   many. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, int index,
+                struct pci_address *a) 
+{
+  return find (match_class, ((uint32_t) class << 8) | subclass, index, a);
+}
+
+/* Matches functions whose vendor and device IDs equal AUX. */
+static bool
+match_device (uint32_t id, uint32_t class UNUSED, uint32_t aux) 
+{
+  return id == aux;
+}
+
+/* Finds the INDEX'th PCI function, counting from 0, with the
+   given VENDOR and DEVICE IDs, and stores its address into *A.
+   Returns true if successful, false if there are not that
+   many. */
+bool
+pci_find_device (uint16_t vendor, uint16_t device, int index,
+                 struct pci_address *a) 
+{
+  return find (match_device, ((uint32_t) device << 16) | vendor, index, a);
+}
@@ -0,0 +1,41 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Location of a PCI function. */
+struct pci_address
+  {
+    uint8_t bus;                /* Bus number, 0...255. */
+    uint8_t dev;                /* Device number, 0...31. */
+    uint8_t func;               /* Function number, 0...7. */
+  };
+
+/* Offsets of configuration space registers common to all PCI
+   functions.  Refer to [PCI] for details. */
+#define PCI_REG_ID 0x00         /* Vendor ID (15:0), Device ID (31:16). */
+#define PCI_REG_COMMAND 0x04    /* Command (15:0), Status (31:16). */
+#define PCI_REG_CLASS 0x08      /* Revision, Prog IF, Subclass, Class. */
+#define PCI_REG_HEADER 0x0c     /* Header type is bits 23:16. */
+#define PCI_REG_BAR0 0x10       /* Base address registers 0...5. */
+#define PCI_REG_IRQ 0x3c        /* Interrupt line (7:0). */
+
+/* Command register bits. */
+#define PCI_COMMAND_IO 0x0001           /* Respond to I/O space accesses. */
+#define PCI_COMMAND_MEMORY 0x0002       /* Respond to memory accesses. */
+#define PCI_COMMAND_MASTER 0x0004       /* Allow bus mastering. */
+
+/* Base address register bits. */
+#define PCI_BAR_IO 0x1                  /* I/O space, not memory. */
+#define PCI_BAR_IO_MASK 0xfffffffc      /* I/O port base address. */
+
+uint32_t pci_read_config (struct pci_address, uint8_t reg);
+void pci_write_config (struct pci_address, uint8_t reg, uint32_t);
+
+bool pci_find_class (uint8_t class, uint8_t subclass, int index,
+                     struct pci_address *);
+bool pci_find_device (uint16_t vendor, uint16_t device, int index,
+                      struct pci_address *);
+
+#endif /* devices/pci.h */
@@ -1,7 +1,8 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -33,6 +34,14 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* Both set if FIFOs are enabled. */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -51,14 +60,56 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Size of the transmit FIFO: 16 bytes on a 16550A, 1 byte if the
+   UART turns out to have no working FIFO. */
+static int fifo_size;
+
+/* Transmit ring buffer size, in bytes.  Must be a power of 2.
+   Large enough that a user program writing a burst of output to
+   the console rarely has to wait for the UART to catch up. */
+#define TXQ_SIZE 8192
+
+/* Data to be transmitted, shared with the interrupt handler,
+   which removes bytes at txq_tail while threads add them at
+   txq_head.  Both only increase, wrapping around; accessed only
+   with interrupts off. */
+static uint8_t txq[TXQ_SIZE];
+static unsigned txq_head, txq_tail;
+
+/* A thread waiting for room in txq, and a lock to ensure that
+   only one thread waits at a time. */
+static struct thread *txq_waiter;
+static struct lock txq_lock;
+
+/* Statistics. */
+static long long xmit_cnt;      /* Bytes transmitted. */
+static long long intr_cnt;      /* Transmit interrupts that sent data. */
+static long long poll_cnt;      /* Bytes sent by polling with a full ring. */
+static long long stall_cnt;     /* Times a thread waited for ring space. */
+static int64_t stall_usecs;     /* Total time spent waiting. */
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
+static void make_room (enum intr_level);
 static intr_handler_func serial_interrupt;
 
+/* Returns the number of bytes waiting in txq. */
+static inline unsigned
+txq_used (void) 
+{
+  return txq_head - txq_tail;
+}
+
+/* Removes and returns the oldest byte in txq, which must not be
+   empty. */
+static inline uint8_t
+txq_getc (void) 
+{
+  ASSERT (txq_used () > 0);
+  return txq[txq_tail++ % TXQ_SIZE];
+}
+
 /* Initializes the serial port device for polling mode.
    Polling mode busy-waits for the serial port to become free
    before writing to it.  It's slow, but until interrupts have
@@ -71,13 +122,13 @@ init_poll (void)
   outb (FCR_REG, 0);                    /* Disable FIFO. */
   set_serial (115200);                  /* 115.2 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
   mode = POLL;
 } 
 
 /* Initializes the serial port device for queued interrupt-driven
    I/O.  With interrupt-driven I/O we don't waste CPU time
-   waiting for the serial device to become ready. */
+   waiting for the serial device to become ready.  Each transmit
+   interrupt refills the whole 16-byte FIFO. */
 void
 serial_init_queue (void) 
 {
@@ -87,6 +138,12 @@ serial_init_queue (void)
     init_poll ();
   ASSERT (mode == POLL);
 
+  /* Enable the FIFOs, keeping the receive trigger level at 1
+     byte so that input is seen promptly. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
+  fifo_size = (inb (IIR_REG) & IIR_FIFO) == IIR_FIFO ? 16 : 1;
+
+  lock_init (&txq_lock);
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
   mode = QUEUE;
   old_level = intr_disable ();
@@ -112,20 +169,55 @@ serial_putc (uint8_t byte)
     {
       /* Otherwise, queue a byte and update the interrupt enable
          register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      if (txq_used () == TXQ_SIZE)
+        make_room (old_level);
+      txq[txq_head++ % TXQ_SIZE] = byte;
+      write_ier ();
+    }
+  
+  intr_set_level (old_level);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  Equivalent to
+   calling serial_putc() for each byte, but copies as much as
+   fits into the transmit ring at a time. */
+void
+serial_putbuf (const char *buffer, size_t n) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (mode != QUEUE)
+    {
+      if (mode == UNINIT)
+        init_poll ();
+      while (n-- > 0)
+        putc_poll (*buffer++);
+    }
+  else
+    {
+      while (n > 0) 
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          unsigned ofs, chunk;
+
+          if (txq_used () == TXQ_SIZE)
+            make_room (old_level);
+
+          /* Copy up to the end of the ring or of the free space,
+             whichever comes first. */
+          ofs = txq_head % TXQ_SIZE;
+          chunk = TXQ_SIZE - txq_used ();
+          if (chunk > TXQ_SIZE - ofs)
+            chunk = TXQ_SIZE - ofs;
+          if (chunk > n)
+            chunk = n;
+          memcpy (txq + ofs, buffer, chunk);
+          txq_head += chunk;
+          buffer += chunk;
+          n -= chunk;
         }
-
-      intq_putc (&txq, byte); 
       write_ier ();
     }
-  
+
   intr_set_level (old_level);
 }
 
@@ -135,11 +227,21 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (txq_used () > 0)
+    putc_poll (txq_getc ());
   intr_set_level (old_level);
 }
 
+/* Prints serial port statistics. */
+void
+serial_print_stats (void) 
+{
+  printf ("Serial: %lld bytes sent in %lld interrupts, %lld polled\n",
+          xmit_cnt, intr_cnt, poll_cnt);
+  printf ("Serial: %lld stalls on a full buffer, %lld us\n",
+          stall_cnt, stall_usecs);
+}
+
 /* The fullness of the input buffer may have changed.  Reassess
    whether we should block receive interrupts.
    Called by the input buffer routines when characters are added
@@ -182,7 +284,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (txq_used () > 0)
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -205,6 +307,40 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Makes room for at least one byte in the full transmit ring.
+   OLD_LEVEL is the interrupt level of our caller.  If interrupts
+   were on, sleeps until the interrupt handler has drained half
+   the ring.  Otherwise, if we wanted to wait for the ring to
+   drain, we'd have to reenable interrupts.  That's impolite, so
+   we send a byte via polling instead. */
+static void
+make_room (enum intr_level old_level) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (old_level == INTR_OFF) 
+    {
+      putc_poll (txq_getc ());
+      xmit_cnt++;
+      poll_cnt++;
+      return;
+    }
+
+  lock_acquire (&txq_lock);
+  if (txq_used () == TXQ_SIZE) 
+    {
+      int64_t start = timer_usecs ();
+
+      write_ier ();
+      txq_waiter = thread_current ();
+      thread_block ();
+
+      stall_cnt++;
+      stall_usecs += timer_usecs () - start;
+    }
+  lock_release (&txq_lock);
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
@@ -218,10 +354,24 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmitter is idle, refill its FIFO from the ring.
+     THRE means that the whole FIFO is empty. */
+  if (txq_used () > 0 && (inb (LSR_REG) & LSR_THRE) != 0) 
+    {
+      int i;
+
+      for (i = 0; i < fifo_size && txq_used () > 0; i++)
+        outb (THR_REG, txq_getc ());
+      xmit_cnt += i;
+      intr_cnt++;
+    }
+
+  /* Wake a thread waiting for room once half the ring is free. */
+  if (txq_waiter != NULL && txq_used () <= TXQ_SIZE / 2) 
+    {
+      thread_unblock (txq_waiter);
+      txq_waiter = NULL;
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
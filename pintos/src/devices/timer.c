@@ -105,6 +105,34 @@ timer_ticks (void)
   return t;
 }
 
+/* Returns the number of microseconds since the OS booted.
+   Timer ticks are too coarse to time events such as disk
+   requests, so this adds how far the 8254 has counted toward the
+   next tick. */
+int64_t
+timer_usecs (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  uint16_t period = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+  int64_t t = ticks;
+  uint16_t count;
+  uint8_t irr;
+
+  outb (0x43, 0x00);    /* CW: latch counter 0. */
+  count = inb (0x40);
+  count |= inb (0x40) << 8;
+  outb (0x20, 0x0a);    /* OCW3: read IRR. */
+  irr = inb (0x20);
+  intr_set_level (old_level);
+
+  /* If the counter has started another period but its interrupt
+     is still pending, then TICKS is one behind. */
+  if ((irr & 1) && count > period / 2)
+    t++;
+  return (t * 1000000 / TIMER_FREQ
+          + (int64_t) (period - count) * 1000000 / 1193180);
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -20,11 +20,22 @@ static size_t cx, cy;
 /* Attribute value for gray text on a black background. */
 #define GRAY_ON_BLACK 0x07
 
+/* Two blank gray-on-black character cells, as a 32-bit word. */
+#define BLANK_PAIR (0x00010001u * (' ' | (GRAY_ON_BLACK << 8)))
+
+/* Number of 32-bit words in a row of the framebuffer. */
+#define ROW_WORDS (COL_CNT * 2 / sizeof (uint32_t))
+
 /* Framebuffer.  See [FREEVGA] under "VGA Text Mode Operation".
    The character at (x,y) is fb[y][x][0].
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/* True if output to the display has been turned off. */
+static bool disabled;
+
+static void put_char (int c);
+static size_t put_span (const char *, size_t);
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
@@ -45,17 +56,73 @@ init (void)
     }
 }
 
+/* Turns off all further output to the display, for running
+   without one. */
+void
+vga_disable (void) 
+{
+  disabled = true;
+}
+
 /* Writes C to the VGA text display, interpreting control
    characters in the conventional ways.  */
 void
 vga_putc (int c)
 {
+  enum intr_level old_level;
+
+  if (disabled)
+    return;
+
   /* Disable interrupts to lock out interrupt handlers
      that might write to the console. */
-  enum intr_level old_level = intr_disable ();
+  old_level = intr_disable ();
+
+  init ();
+  put_char (c);
+
+  /* Update cursor position. */
+  move_cursor ();
+
+  intr_set_level (old_level);
+}
+
+/* Writes the N characters in BUFFER to the VGA text display, as
+   if by vga_putc() for each one, but copying runs of ordinary
+   characters straight into the framebuffer and updating the
+   hardware cursor only once at the end. */
+void
+vga_putbuf (const char *buffer, size_t n) 
+{
+  enum intr_level old_level;
+
+  if (disabled)
+    return;
+
+  old_level = intr_disable ();
 
   init ();
-  
+  while (n > 0) 
+    {
+      size_t span = put_span (buffer, n);
+      if (span == 0) 
+        {
+          put_char (*buffer);
+          span = 1;
+        }
+      buffer += span;
+      n -= span;
+    }
+  move_cursor ();
+
+  intr_set_level (old_level);
+}
+
+/* Writes C to the display at the cursor position, without
+   updating the hardware cursor. */
+static void
+put_char (int c) 
+{
   switch (c) 
     {
     case '\n':
@@ -88,11 +155,29 @@ vga_putc (int c)
         newline ();
       break;
     }
+}
 
-  /* Update cursor position. */
-  move_cursor ();
+/* Writes the longest prefix of the N characters in BUFFER that
+   contains no control characters handled by put_char() and fits
+   in the rest of the current row, and returns its length. */
+static size_t
+put_span (const char *buffer, size_t n) 
+{
+  size_t span;
 
-  intr_set_level (old_level);
+  if (n > COL_CNT - cx)
+    n = COL_CNT - cx;
+  for (span = 0; span < n && strchr ("\n\f\b\r\t", buffer[span]) == NULL;
+       span++) 
+    {
+      fb[cy][cx + span][0] = buffer[span];
+      fb[cy][cx + span][1] = GRAY_ON_BLACK;
+    }
+
+  cx += span;
+  if (cx >= COL_CNT)
+    newline ();
+  return span;
 }
 
 /* Clears the screen and moves the cursor to the upper left. */
@@ -112,13 +197,11 @@ cls (void)
 static void
 clear_row (size_t y) 
 {
-  size_t x;
+  uint32_t *row = (uint32_t *) fb[y];
+  size_t i;
 
-  for (x = 0; x < COL_CNT; x++)
-    {
-      fb[y][x][0] = ' ';
-      fb[y][x][1] = GRAY_ON_BLACK;
-    }
+  for (i = 0; i < ROW_WORDS; i++)
+    row[i] = BLANK_PAIR;
 }
 
 /* Advances the cursor to the first column in the next line on
@@ -131,8 +214,13 @@ newline (void)
   cy++;
   if (cy >= ROW_CNT)
     {
+      uint32_t *words = (uint32_t *) fb;
+      size_t i;
+
+      /* Scroll up a word at a time: memmove() copies bytes. */
       cy = ROW_CNT - 1;
-      memmove (&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
+      for (i = 0; i < ROW_WORDS * (ROW_CNT - 1); i++)
+        words[i] = words[i + ROW_WORDS];
       clear_row (ROW_CNT - 1);
     }
 }
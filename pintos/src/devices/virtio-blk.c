@@ -0,0 +1,414 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/disk.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The code in this file drives virtio block devices, which QEMU
+   provides to guests as a much faster alternative to an emulated
+   IDE disk: a request is handed to the device by adding it to a
+   ring in memory and notifying the device with a single port
+   write, the device moves the data by DMA, and several requests
+   may be outstanding at once.  We use the "legacy" PCI interface
+   described in section 4.1 of [VIRTIO].
+
+   Each device is registered with the generic disk layer.  If the
+   device's serial number names an ATA position, e.g. "hd0:1",
+   then the device stands in for the disk at that position; this
+   is how the pintos script's --virtio option puts the file system
+   and swap disks on virtio. */
+
+/* PCI IDs of a legacy virtio block device. */
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK_DEVICE 0x1001
+
+/* Legacy virtio registers, at offsets from the I/O port in BAR 0. */
+#define REG_HOST_FEATURES 0x00  /* Device features (32 bits). */
+#define REG_GUEST_FEATURES 0x04 /* Driver features (32 bits). */
+#define REG_QUEUE_PFN 0x08      /* Queue page frame number (32 bits). */
+#define REG_QUEUE_SIZE 0x0c     /* Queue size (16 bits, r/o). */
+#define REG_QUEUE_SELECT 0x0e   /* Queue selector (16 bits). */
+#define REG_QUEUE_NOTIFY 0x10   /* Queue notifier (16 bits). */
+#define REG_STATUS 0x12         /* Device status (8 bits). */
+#define REG_ISR 0x13            /* Interrupt status (8 bits, r/o). */
+#define REG_CAPACITY 0x14       /* Capacity in sectors (64 bits, r/o). */
+
+/* Device status bits. */
+#define STATUS_ACKNOWLEDGE 0x01 /* Guest has found the device. */
+#define STATUS_DRIVER 0x02      /* Guest has a driver for it. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+#define STATUS_FAILED 0x80      /* Driver gave up on the device. */
+
+/* Interrupt status bits. */
+#define ISR_QUEUE 0x01          /* A used ring was updated. */
+
+/* Virtqueue memory layout alignment for the legacy interface. */
+#define VRING_ALIGN 4096
+
+/* A virtqueue descriptor, describing one physically contiguous
+   buffer.  Descriptors may be chained to describe a request made
+   of several buffers. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address. */
+    uint32_t len;               /* Length in bytes. */
+    uint16_t flags;             /* VRING_DESC_F_* flags. */
+    uint16_t next;              /* Next descriptor, if VRING_DESC_F_NEXT. */
+  };
+#define VRING_DESC_F_NEXT 1     /* Chained to NEXT. */
+#define VRING_DESC_F_WRITE 2    /* Device writes (rather than reads). */
+
+/* Ring of descriptor chains made available to the device. */
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where the driver puts the next entry. */
+    uint16_t ring[];            /* Heads of descriptor chains. */
+  };
+
+/* Ring of descriptor chains the device is done with. */
+struct vring_used_elem
+  {
+    uint32_t id;                /* Head of descriptor chain. */
+    uint32_t len;               /* Bytes written into the chain. */
+  };
+
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where the device puts the next entry. */
+    struct vring_used_elem ring[];
+  };
+
+/* The header that starts a virtio block request, followed by the
+   data and then a status byte. */
+struct virtio_blk_header
+  {
+    uint32_t type;              /* VIRTIO_BLK_T_* request type. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+#define VIRTIO_BLK_T_IN 0       /* Read. */
+#define VIRTIO_BLK_T_OUT 1      /* Write. */
+#define VIRTIO_BLK_T_GET_ID 8   /* Get serial number. */
+#define VIRTIO_BLK_S_OK 0       /* Status of a request that succeeded. */
+#define VIRTIO_BLK_ID_BYTES 20  /* Maximum length of a serial number. */
+
+/* Maximum number of requests outstanding on a device at once.
+   Each takes three descriptors: header, data, and status. */
+#define SLOT_CNT 32
+
+/* An outstanding request. */
+struct slot
+  {
+    struct virtio_blk_header header;    /* Read by the device. */
+    uint8_t status;                     /* Written by the device. */
+    bool in_use;                        /* Slot holds a request? */
+    struct disk_request *request;       /* Request, or a null pointer for
+                                           our own GET_ID request. */
+  };
+
+/* A virtio block device. */
+struct virtio_blk
+  {
+    char name[8];               /* Name, e.g. "vda". */
+    uint16_t io_base;           /* Base I/O port. */
+    uint8_t irq;                /* Interrupt in use. */
+    struct disk *disk;          /* Registered disk, once registered. */
+
+    uint16_t queue_size;        /* Number of descriptors in the queue. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Available ring. */
+    volatile struct vring_used *used;   /* Used ring. */
+    uint16_t used_idx;          /* Used ring entries consumed so far. */
+
+    size_t slot_cnt;            /* Number of usable slots. */
+    struct slot slots[SLOT_CNT];        /* Requests.  Slot I uses
+                                           descriptors 3*I...3*I+2. */
+    struct semaphore free_slots;        /* Number of free slots. */
+    struct semaphore id_done;   /* Up'd when our GET_ID completes. */
+    char id[VIRTIO_BLK_ID_BYTES + 1];   /* Serial number. */
+  };
+
+/* We support a few devices, which is as many disks as Pintos
+   uses. */
+#define DEVICE_CNT 4
+static struct virtio_blk devices[DEVICE_CNT];
+static size_t device_cnt;
+
+static bool init_device (struct virtio_blk *, struct pci_address);
+static void queue_request (struct virtio_blk *, uint32_t type,
+                           uint64_t sector, void *buffer, size_t size,
+                           bool device_writes, struct disk_request *);
+static disk_submit_func submit;
+static intr_handler_func interrupt_handler;
+
+/* Detects virtio block devices and registers them as disks. */
+void
+virtio_blk_init (void)
+{
+  struct pci_address a;
+  int i;
+
+  for (i = 0; pci_find_device (VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, i, &a); i++)
+    {
+      struct virtio_blk *vb = &devices[device_cnt];
+      disk_sector_t capacity;
+      uint32_t capacity_hi;
+      const char *alias;
+
+      if (device_cnt >= DEVICE_CNT)
+        {
+          printf ("virtio-blk: ignoring devices after the first %d\n",
+                  DEVICE_CNT);
+          break;
+        }
+      snprintf (vb->name, sizeof vb->name, "vd%c", 'a' + (int) device_cnt);
+      if (!init_device (vb, a))
+        continue;
+      device_cnt++;
+
+      /* Read the serial number, which says which ATA disk, if any,
+         this device replaces. */
+      queue_request (vb, VIRTIO_BLK_T_GET_ID, 0, vb->id,
+                     VIRTIO_BLK_ID_BYTES, true, NULL);
+      sema_down (&vb->id_done);
+      alias = NULL;
+      if (!memcmp (vb->id, "hd", 2) && vb->id[2] >= '0' && vb->id[2] <= '9'
+          && vb->id[3] == ':' && (vb->id[4] == '0' || vb->id[4] == '1')
+          && vb->id[5] == '\0')
+        alias = vb->id;
+
+      /* Disks bigger than 2 TB are truncated. */
+      capacity = inl (vb->io_base + REG_CAPACITY);
+      capacity_hi = inl (vb->io_base + REG_CAPACITY + 4);
+      if (capacity_hi != 0)
+        capacity = UINT32_MAX;
+
+      printf ("%s: detected %'"PRDSNu" sector (", vb->name, capacity);
+      if (capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
+        printf ("%"PRDSNu" GB",
+                capacity / (1024 / DISK_SECTOR_SIZE * 1024 * 1024));
+      else if (capacity > 1024 / DISK_SECTOR_SIZE * 1024)
+        printf ("%"PRDSNu" MB", capacity / (1024 / DISK_SECTOR_SIZE * 1024));
+      else if (capacity > 1024 / DISK_SECTOR_SIZE)
+        printf ("%"PRDSNu" kB", capacity / (1024 / DISK_SECTOR_SIZE));
+      else
+        printf ("%"PRDSNu" byte", capacity * DISK_SECTOR_SIZE);
+      printf (") virtio disk");
+      if (alias != NULL)
+        printf (", in place of %s", alias);
+      printf ("\n");
+
+      vb->disk = disk_register (vb->name, alias, capacity, submit, vb);
+    }
+}
+
+/* Resets and initializes device VB at PCI address A, allocates
+   and installs its virtqueue, and enables its interrupt.  Returns
+   true if successful, false if the device cannot be used. */
+static bool
+init_device (struct virtio_blk *vb, struct pci_address a)
+{
+  uint32_t bar = pci_read_config (a, PCI_REG_BAR0);
+  size_t desc_size, avail_size, used_ofs, used_size;
+  size_t i;
+  uint8_t *queue;
+
+  if (!(bar & PCI_BAR_IO))
+    {
+      printf ("%s: no I/O ports, ignoring\n", vb->name);
+      return false;
+    }
+  vb->io_base = bar & PCI_BAR_IO_MASK;
+  vb->irq = pci_read_config (a, PCI_REG_IRQ) & 0xff;
+  if (vb->irq == 0 || vb->irq >= 16)
+    {
+      printf ("%s: no interrupt line, ignoring\n", vb->name);
+      return false;
+    }
+  pci_write_config (a, PCI_REG_COMMAND,
+                    (pci_read_config (a, PCI_REG_COMMAND)
+                     | PCI_COMMAND_IO | PCI_COMMAND_MASTER));
+
+  /* Reset the device and tell it we have a driver.  We need none
+     of its optional features. */
+  outb (vb->io_base + REG_STATUS, 0);
+  outb (vb->io_base + REG_STATUS, STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  outl (vb->io_base + REG_GUEST_FEATURES, 0);
+
+  /* Allocate queue 0, the only one a block device has.  The
+     descriptor table and available ring come first, then the used
+     ring on the next VRING_ALIGN boundary. */
+  outw (vb->io_base + REG_QUEUE_SELECT, 0);
+  vb->queue_size = inw (vb->io_base + REG_QUEUE_SIZE);
+  if (vb->queue_size < 3)
+    {
+      printf ("%s: queue too small, ignoring\n", vb->name);
+      outb (vb->io_base + REG_STATUS, STATUS_FAILED);
+      return false;
+    }
+  desc_size = sizeof *vb->desc * vb->queue_size;
+  avail_size = sizeof *vb->avail + sizeof *vb->avail->ring * vb->queue_size;
+  used_ofs = ROUND_UP (desc_size + avail_size, VRING_ALIGN);
+  used_size = (sizeof *vb->used
+               + sizeof *vb->used->ring * vb->queue_size);
+  queue = palloc_get_multiple (PAL_ZERO,
+                               DIV_ROUND_UP (used_ofs + used_size, PGSIZE));
+  if (queue == NULL)
+    {
+      printf ("%s: out of memory for queue, ignoring\n", vb->name);
+      outb (vb->io_base + REG_STATUS, STATUS_FAILED);
+      return false;
+    }
+  vb->desc = (struct vring_desc *) queue;
+  vb->avail = (struct vring_avail *) (queue + desc_size);
+  vb->used = (struct vring_used *) (queue + used_ofs);
+  vb->used_idx = 0;
+
+  /* Chain each slot's three descriptors together for good. */
+  vb->slot_cnt = vb->queue_size / 3 < SLOT_CNT ? vb->queue_size / 3 : SLOT_CNT;
+  for (i = 0; i < vb->slot_cnt; i++)
+    {
+      struct slot *s = &vb->slots[i];
+      struct vring_desc *d = &vb->desc[3 * i];
+
+      d[0].addr = vtop (&s->header);
+      d[0].len = sizeof s->header;
+      d[0].flags = VRING_DESC_F_NEXT;
+      d[0].next = 3 * i + 1;
+      d[1].flags = VRING_DESC_F_NEXT;
+      d[1].next = 3 * i + 2;
+      d[2].addr = vtop (&s->status);
+      d[2].len = sizeof s->status;
+      d[2].flags = VRING_DESC_F_WRITE;
+      s->in_use = false;
+    }
+  sema_init (&vb->free_slots, vb->slot_cnt);
+  sema_init (&vb->id_done, 0);
+
+  /* Devices may share an interrupt line, so register the handler
+     only once per line. */
+  for (i = 0; i < device_cnt; i++)
+    if (devices[i].irq == vb->irq)
+      break;
+  if (i == device_cnt)
+    intr_register_ext (vb->irq + 0x20, interrupt_handler, vb->name);
+
+  outl (vb->io_base + REG_QUEUE_PFN, vtop (queue) / VRING_ALIGN);
+  outb (vb->io_base + REG_STATUS,
+        STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+  return true;
+}
+
+/* Carries out disk request R on the device VB_. */
+static void
+submit (void *vb_, struct disk_request *r)
+{
+  struct virtio_blk *vb = vb_;
+
+  queue_request (vb, r->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
+                 r->sec_no, r->buffer, r->cnt * DISK_SECTOR_SIZE,
+                 !r->write, r);
+}
+
+/* Makes a request of type TYPE, for SECTOR, with the SIZE bytes
+   of data in BUFFER, available to device VB, and notifies the
+   device.  The device writes into BUFFER if DEVICE_WRITES is
+   true, otherwise it reads from it.  R is the disk request to
+   complete when the device is done, or a null pointer to up
+   VB's id_done semaphore instead.  Waits for a free slot if
+   SLOT_CNT requests are already outstanding. */
+static void
+queue_request (struct virtio_blk *vb, uint32_t type, uint64_t sector,
+               void *buffer, size_t size, bool device_writes,
+               struct disk_request *r)
+{
+  enum intr_level old_level;
+  struct vring_desc *d;
+  struct slot *s;
+  size_t i;
+
+  sema_down (&vb->free_slots);
+
+  /* The interrupt handler also touches the slots and rings. */
+  old_level = intr_disable ();
+  for (i = 0; vb->slots[i].in_use; i++)
+    ASSERT (i + 1 < vb->slot_cnt);
+  s = &vb->slots[i];
+  s->in_use = true;
+  s->request = r;
+  s->header.type = type;
+  s->header.reserved = 0;
+  s->header.sector = sector;
+  s->status = 0xff;
+
+  d = &vb->desc[3 * i + 1];
+  d->addr = vtop (buffer);
+  d->len = size;
+  d->flags = VRING_DESC_F_NEXT | (device_writes ? VRING_DESC_F_WRITE : 0);
+
+  /* The device must see the ring entry before the new index, and
+     the new index before the notification. */
+  vb->avail->ring[vb->avail->idx % vb->queue_size] = 3 * i;
+  barrier ();
+  vb->avail->idx++;
+  barrier ();
+  outw (vb->io_base + REG_QUEUE_NOTIFY, 0);
+  intr_set_level (old_level);
+}
+
+/* Virtio block interrupt handler.  Completes the requests that
+   every device on the interrupting line is done with. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < device_cnt; i++)
+    {
+      struct virtio_blk *vb = &devices[i];
+
+      /* Reading the interrupt status acknowledges the interrupt. */
+      if (f->vec_no != vb->irq + 0x20u
+          || !(inb (vb->io_base + REG_ISR) & ISR_QUEUE))
+        continue;
+
+      while (vb->used_idx != vb->used->idx)
+        {
+          struct vring_used_elem *e;
+          struct slot *s;
+
+          barrier ();
+          e = (struct vring_used_elem *)
+            &vb->used->ring[vb->used_idx % vb->queue_size];
+          s = &vb->slots[e->id / 3];
+          vb->used_idx++;
+
+          if (s->status != VIRTIO_BLK_S_OK)
+            {
+              if (s->request != NULL)
+                PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+                       vb->name, s->request->write ? "write" : "read",
+                       s->request->sec_no);
+              vb->id[0] = '\0';
+            }
+
+          s->in_use = false;
+          if (s->request != NULL)
+            disk_complete (s->request);
+          else
+            sema_up (&vb->id_done);
+          sema_up (&vb->free_slots);
+        }
+    }
+}
@@ -5,6 +5,7 @@
 
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *line);
 
 int
 main (void)
@@ -30,6 +31,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command);
       else
         {
           pid_t pid = exec (command);
@@ -44,6 +47,64 @@ main (void)
   return EXIT_SUCCESS;
 }
 
+/* Runs the commands in LINE, which are separated by `|', all at
+   once, with the standard output of each one connected to the
+   standard input of the next through a pipe.  The shell's own
+   descriptors 0 and 1 are pointed at the pipes only while it
+   starts each command, since children inherit them. */
+static void
+run_pipeline (char *line) 
+{
+  enum { MAX_CMDS = 8 };
+  char *cmds[MAX_CMDS];
+  pid_t pids[MAX_CMDS];
+  int cmd_cnt = 0;
+  char *cmd, *save_ptr;
+  int i;
+
+  for (cmd = strtok_r (line, "|", &save_ptr); cmd != NULL;
+       cmd = strtok_r (NULL, "|", &save_ptr)) 
+    {
+      if (cmd_cnt >= MAX_CMDS) 
+        {
+          printf ("too many commands in pipeline\n");
+          return;
+        }
+      while (*cmd == ' ')
+        cmd++;
+      cmds[cmd_cnt++] = cmd;
+    }
+
+  for (i = 0; i < cmd_cnt; i++) 
+    {
+      int fds[2];
+      bool piped = i < cmd_cnt - 1 && pipe (fds) == 0;
+
+      if (piped) 
+        {
+          dup2 (fds[1], STDOUT_FILENO);
+          close (fds[1]);
+        }
+      pids[i] = exec (cmds[i]);
+
+      /* Get the console back, then read from this command's
+         output while starting the next one. */
+      close (STDIN_FILENO);
+      close (STDOUT_FILENO);
+      if (piped) 
+        {
+          dup2 (fds[0], STDIN_FILENO);
+          close (fds[0]);
+        }
+    }
+
+  for (i = 0; i < cmd_cnt; i++) 
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", cmds[i], wait (pids[i]));
+    else
+      printf ("\"%s\": exec failed\n", cmds[i]);
+}
+
 /* Reads a line of input from the user into LINE, which has room
    for SIZE bytes.  Handles backspace and Ctrl+U in the ways
    expected by Unix users.  On return, LINE will always be
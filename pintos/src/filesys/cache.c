@@ -0,0 +1,580 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Buffer cache for sectors on the file system disk.
+
+   All file system I/O goes through the cache.  CACHE_LOCK
+   protects the mapping from sectors to blocks and is only held
+   briefly; each block has its own lock that is held while its
+   data is read from disk or copied in or out, so that accesses
+   to different sectors proceed in parallel.  A block's USE_CNT
+   counts the threads that are using it or waiting for its lock,
+   and only blocks whose USE_CNT is zero are replaced.
+
+   File data written with cache_write() or cache_write_at() stays
+   in the cache, marked dirty, until its block is replaced or
+   cache_flush() or cache_flush_all() writes it back.  Each dirty
+   block remembers the inode it belongs to, so that one file can
+   be flushed without the others.  Metadata written with
+   cache_log() or cache_log_at() goes to the journal instead, and
+   a sector that is in the journal is read from there when it is
+   not cached.  cache_zero() bypasses the cache for sectors that
+   are not already in it, so that zeroing a large range does not
+   evict everything else.
+
+   Dirty blocks for consecutive sectors are written back together,
+   gathered into a single disk write of up to CLUSTER_SECTORS
+   sectors: a flush writes back runs of them, and a dirty block
+   chosen for replacement takes its idle dirty neighbors along.
+   A partial write to a sector that is not cached has to read the
+   rest of the sector first, unless the writer says that none of
+   the sector's contents matter yet. */
+
+/* Number of sectors in the cache. */
+#define CACHE_CNT 64
+
+/* Most sectors written back by a single disk write. */
+#define CLUSTER_SECTORS 16
+
+/* A cached sector. */
+struct cache_block
+  {
+    /* Protected by cache_lock. */
+    disk_sector_t sector;       /* Sector held, if IN_USE. */
+    bool in_use;                /* Holds a sector? */
+    bool accessed;              /* Used since the clock hand passed? */
+    int use_cnt;                /* Threads using this block. */
+
+    /* Protected by LOCK.  DIRTY and OWNER may also be read, as a
+       hint, with just cache_lock held. */
+    struct lock lock;           /* Protects the members below. */
+    bool valid;                 /* DATA holds the sector's contents? */
+    bool dirty;                 /* DATA newer than the disk? */
+    disk_sector_t owner;        /* Inode sector of DATA's file, if DIRTY. */
+    uint8_t *data;              /* DISK_SECTOR_SIZE bytes of data. */
+  };
+
+static struct cache_block cache[CACHE_CNT];
+static struct lock cache_lock;
+static size_t clock_hand;
+
+/* Staging buffer in which consecutive dirty sectors are gathered
+   for a single disk write.  CLUSTER_LOCK protects it and the
+   write statistics below, and is never held while acquiring a
+   block's lock. */
+static uint8_t *cluster_buffer;
+static struct lock cluster_lock;
+
+/* Statistics. */
+static long long hit_cnt;       /* Lookups that found their sector. */
+static long long miss_cnt;      /* Lookups that had to replace a block. */
+static long long write_back_cnt; /* Dirty blocks written back. */
+static long long zero_cnt;      /* Sectors zeroed bypassing the cache. */
+static long long write_cnt;     /* Disk writes that wrote either. */
+static long long partial_cnt;   /* Partial writes to uncached sectors. */
+static long long partial_read_cnt; /* Those that read the sector. */
+
+/* Initializes the buffer cache. */
+void
+cache_init (void) 
+{
+  size_t page_cnt = DIV_ROUND_UP (CACHE_CNT * DISK_SECTOR_SIZE, PGSIZE);
+  uint8_t *data = palloc_get_multiple (PAL_ASSERT, page_cnt);
+  size_t i;
+
+  lock_init (&cache_lock);
+  cluster_buffer = palloc_get_multiple (PAL_ASSERT,
+                                        DIV_ROUND_UP (CLUSTER_SECTORS
+                                                      * DISK_SECTOR_SIZE,
+                                                      PGSIZE));
+  lock_init (&cluster_lock);
+  for (i = 0; i < CACHE_CNT; i++) 
+    {
+      struct cache_block *b = &cache[i];
+      b->in_use = false;
+      b->accessed = false;
+      b->use_cnt = 0;
+      lock_init (&b->lock);
+      b->valid = false;
+      b->dirty = false;
+      b->data = data + i * DISK_SECTOR_SIZE;
+    }
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void) 
+{
+  printf ("Buffer cache: %lld hits, %lld misses, %lld write-backs "
+          "and %lld zeroed sectors in %lld disk writes\n",
+          hit_cnt, miss_cnt, write_back_cnt, zero_cnt, write_cnt);
+  printf ("Buffer cache: %lld partial writes to uncached sectors, "
+          "%lld read first\n", partial_cnt, partial_read_cnt);
+}
+
+/* Returns the block holding SECTOR, or a null pointer if there
+   is none.  The caller must hold cache_lock. */
+static struct cache_block *
+lookup (disk_sector_t sector) 
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_CNT; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Writes the CNT sectors gathered in cluster_buffer to disk,
+   starting at SECTOR.  The caller must hold cluster_lock. */
+static void
+write_cluster (disk_sector_t sector, size_t cnt) 
+{
+  disk_write_multiple (filesys_disk, sector, cluster_buffer, cnt);
+  write_cnt++;
+}
+
+/* Writes back those of the CNT blocks in RUN that are dirty, each
+   to disk or to the journal if its sector is there.  Dirty blocks
+   for consecutive sectors are written with a single disk write.
+   RUN must be in ascending sector order, and the caller must hold
+   the lock of each of its blocks. */
+static void
+write_back (struct cache_block **run, size_t cnt) 
+{
+  /* Only file data is written back; metadata goes through the
+     journal. */
+  enum disk_user old_user = disk_set_user (DISK_USER_DATA);
+  disk_sector_t start = 0;
+  size_t gathered = 0;
+  size_t i;
+
+  lock_acquire (&cluster_lock);
+  for (i = 0; i < cnt; i++) 
+    {
+      struct cache_block *b = run[i];
+
+      if (!b->dirty)
+        continue;
+      b->dirty = false;
+      write_back_cnt++;
+      if (journal_update (b->sector, b->data))
+        continue;
+
+      if (gathered > 0
+          && (b->sector != start + gathered || gathered == CLUSTER_SECTORS))
+        {
+          write_cluster (start, gathered);
+          gathered = 0;
+        }
+      if (gathered == 0)
+        start = b->sector;
+      memcpy (cluster_buffer + gathered++ * DISK_SECTOR_SIZE, b->data,
+              DISK_SECTOR_SIZE);
+    }
+  if (gathered > 0)
+    write_cluster (start, gathered);
+  lock_release (&cluster_lock);
+  disk_set_user (old_user);
+}
+
+/* Returns true if B is a dirty block that no thread is using.
+   The caller must hold cache_lock. */
+static bool
+idle_dirty (const struct cache_block *b) 
+{
+  return b != NULL && b->use_cnt == 0 && b->dirty;
+}
+
+/* Writes back block B, which must be dirty and not in use by any
+   thread, along with the idle dirty blocks for the sectors around
+   it, up to CLUSTER_SECTORS in all.  The caller must hold
+   cache_lock, which is released during the write and reacquired
+   before returning.  The blocks keep their sectors meanwhile, so
+   that other threads that look them up wait for the write to
+   finish. */
+static void
+clean (struct cache_block *b) 
+{
+  struct cache_block *run[CLUSTER_SECTORS];
+  disk_sector_t first;
+  size_t cnt, i;
+
+  ASSERT (idle_dirty (b));
+
+  /* Gather the run, which includes B, since it is idle and dirty
+     itself. */
+  for (first = b->sector;
+       first > 0 && b->sector - first < CLUSTER_SECTORS / 2
+         && idle_dirty (lookup (first - 1));
+       first--)
+    continue;
+  for (cnt = 0; cnt < CLUSTER_SECTORS; cnt++) 
+    {
+      struct cache_block *c = lookup (first + cnt);
+      if (!idle_dirty (c))
+        break;
+      c->use_cnt++;
+      run[cnt] = c;
+    }
+  lock_release (&cache_lock);
+
+  for (i = 0; i < cnt; i++)
+    filesys_lock (&run[i]->lock, FS_LOCK_CACHE);
+  write_back (run, cnt);
+  for (i = 0; i < cnt; i++)
+    lock_release (&run[i]->lock);
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cnt; i++)
+    run[i]->use_cnt--;
+}
+
+/* Chooses a block that is not in use by any thread, using the
+   clock algorithm, and returns it.  Dirty blocks are written
+   back before they are chosen.  Waits for a block to become
+   free if necessary.  The caller must hold cache_lock. */
+static struct cache_block *
+evict (void) 
+{
+  for (;;) 
+    {
+      size_t i;
+
+      /* Two sweeps are enough to find any idle block. */
+      for (i = 0; i < 2 * CACHE_CNT; i++) 
+        {
+          struct cache_block *b = &cache[clock_hand];
+          clock_hand = (clock_hand + 1) % CACHE_CNT;
+
+          if (b->use_cnt > 0)
+            continue;
+          if (b->in_use && b->accessed) 
+            {
+              b->accessed = false;
+              continue;
+            }
+          if (b->in_use && b->dirty) 
+            {
+              /* Somebody may have used B while it was written. */
+              clean (b);
+              if (b->use_cnt > 0 || b->accessed || b->dirty)
+                continue;
+            }
+          return b;
+        }
+
+      /* Every block is busy.  Let their users finish. */
+      lock_release (&cache_lock);
+      thread_yield ();
+      lock_acquire (&cache_lock);
+    }
+}
+
+/* Reads block B's sector into it, from the journal if the
+   sector is there or otherwise from disk.  The caller must hold
+   B's lock. */
+static void
+load_block (struct cache_block *b) 
+{
+  if (!journal_read (b->sector, b->data))
+    disk_read (filesys_disk, b->sector, b->data);
+  b->valid = true;
+}
+
+/* Returns the block for SECTOR with its lock held, replacing
+   another block if SECTOR is not cached.  If LOAD is true, the
+   block's data is read from disk if it is not already valid.
+   The caller must release the block with release(). */
+static struct cache_block *
+acquire (disk_sector_t sector, bool load) 
+{
+  struct cache_block *b;
+
+  lock_acquire (&cache_lock);
+  b = lookup (sector);
+  if (b != NULL)
+    hit_cnt++;
+  else 
+    {
+      miss_cnt++;
+      b = evict ();
+      b->sector = sector;
+      b->in_use = true;
+      b->valid = false;
+      b->dirty = false;
+    }
+  b->accessed = true;
+  b->use_cnt++;
+  lock_release (&cache_lock);
+
+  filesys_lock (&b->lock, FS_LOCK_CACHE);
+  if (load && !b->valid)
+    load_block (b);
+  return b;
+}
+
+/* Releases block B obtained from acquire(). */
+static void
+release (struct cache_block *b) 
+{
+  lock_release (&b->lock);
+
+  lock_acquire (&cache_lock);
+  ASSERT (b->use_cnt > 0);
+  b->use_cnt--;
+  lock_release (&cache_lock);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   DISK_SECTOR_SIZE bytes. */
+void
+cache_read (disk_sector_t sector, void *buffer) 
+{
+  cache_read_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within sector
+   SECTOR into BUFFER. */
+void
+cache_read_at (disk_sector_t sector, void *buffer, int ofs, int size) 
+{
+  struct cache_block *b;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  b = acquire (sector, true);
+  memcpy (buffer, b->data + ofs, size);
+  release (b);
+}
+
+/* Writes SIZE bytes from BUFFER at byte offset OFS within data
+   sector SECTOR of the file whose inode is in sector OWNER.  If
+   the write is partial and the sector is not cached, the rest of
+   the sector is zeroed if FRESH is true, otherwise read from
+   disk. */
+static void
+write_at (disk_sector_t sector, const void *buffer, int ofs, int size,
+          disk_sector_t owner, bool fresh) 
+{
+  struct cache_block *b;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  b = acquire (sector, false);
+  if (!b->valid && size < DISK_SECTOR_SIZE) 
+    {
+      partial_cnt++;
+      if (fresh)
+        memset (b->data, 0, DISK_SECTOR_SIZE);
+      else 
+        {
+          partial_read_cnt++;
+          load_block (b);
+        }
+    }
+  memcpy (b->data + ofs, buffer, size);
+  b->valid = true;
+  b->dirty = true;
+  b->owner = owner;
+  release (b);
+}
+
+/* Writes sector SECTOR, a data sector of the file whose inode
+   is in sector OWNER, from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes. */
+void
+cache_write (disk_sector_t sector, const void *buffer, disk_sector_t owner) 
+{
+  cache_write_at (sector, buffer, 0, DISK_SECTOR_SIZE, owner);
+}
+
+/* Writes SIZE bytes from BUFFER at byte offset OFS within
+   sector SECTOR, a data sector of the file whose inode is in
+   sector OWNER.  The rest of the sector is unchanged.  The
+   sector is written back to disk later. */
+void
+cache_write_at (disk_sector_t sector, const void *buffer, int ofs, int size,
+                disk_sector_t owner) 
+{
+  write_at (sector, buffer, ofs, size, owner, false);
+}
+
+/* Writes SIZE bytes from BUFFER at byte offset OFS within
+   sector SECTOR, a data sector of the file whose inode is in
+   sector OWNER, none of whose current contents matter, such as
+   one that lies wholly past the data written to the file so far.
+   If the sector is not cached, the rest of it becomes zeros
+   without being read from disk.  The sector is written back to
+   disk later. */
+void
+cache_write_fresh_at (disk_sector_t sector, const void *buffer, int ofs,
+                      int size, disk_sector_t owner) 
+{
+  write_at (sector, buffer, ofs, size, owner, true);
+}
+
+/* Writes metadata sector SECTOR from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes, through the journal. */
+void
+cache_log (disk_sector_t sector, const void *buffer) 
+{
+  cache_log_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes from BUFFER at byte offset OFS within
+   metadata sector SECTOR, through the journal.  The rest of the
+   sector is unchanged. */
+void
+cache_log_at (disk_sector_t sector, const void *buffer, int ofs, int size) 
+{
+  struct cache_block *b;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= DISK_SECTOR_SIZE);
+
+  b = acquire (sector, size < DISK_SECTOR_SIZE);
+  memcpy (b->data + ofs, buffer, size);
+  b->valid = true;
+  b->dirty = false;
+  journal_log (sector, b->data);
+  release (b);
+}
+
+/* CLUSTER_SECTORS sectors of zeros. */
+static const uint8_t zeros[CLUSTER_SECTORS * DISK_SECTOR_SIZE];
+
+/* Writes zeros directly to the CNT sectors starting at SECTOR,
+   at most CLUSTER_SECTORS of them, and counts the write. */
+static void
+write_zeros (disk_sector_t sector, size_t cnt) 
+{
+  ASSERT (cnt <= CLUSTER_SECTORS);
+  disk_write_multiple (filesys_disk, sector, zeros, cnt);
+
+  lock_acquire (&cluster_lock);
+  write_cnt++;
+  zero_cnt += cnt;
+  lock_release (&cluster_lock);
+}
+
+/* Writes zeros to the CNT sectors starting at SECTOR, data
+   sectors of the file whose inode is in sector OWNER.  Sectors
+   that are cached are zeroed in the cache; the rest are written
+   directly without being brought into the cache, up to
+   CLUSTER_SECTORS consecutive sectors per disk write.  The caller
+   must ensure that no other thread accesses these sectors in the
+   meantime. */
+void
+cache_zero (disk_sector_t sector, size_t cnt, disk_sector_t owner) 
+{
+  disk_sector_t start = 0;
+  size_t gathered = 0;
+
+  for (; cnt > 0; cnt--, sector++) 
+    {
+      bool cached;
+
+      lock_acquire (&cache_lock);
+      cached = lookup (sector) != NULL;
+      lock_release (&cache_lock);
+
+      if (cached)
+        cache_write (sector, zeros, owner);
+      else if (!journal_update (sector, zeros)) 
+        {
+          if (gathered > 0
+              && (sector != start + gathered || gathered == CLUSTER_SECTORS))
+            {
+              write_zeros (start, gathered);
+              gathered = 0;
+            }
+          if (gathered == 0)
+            start = sector;
+          gathered++;
+        }
+    }
+  if (gathered > 0)
+    write_zeros (start, gathered);
+}
+
+/* Writes back the dirty blocks that belong to the file whose
+   inode is in sector OWNER, or all dirty blocks if ALL is true,
+   in ascending sector order. */
+static void
+flush (bool all, disk_sector_t owner) 
+{
+  struct cache_block *dirty[CACHE_CNT];
+  size_t dirty_cnt = 0;
+  size_t i;
+
+  /* Collect the dirty blocks, sorted by sector, and keep them
+     from being replaced. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_CNT; i++) 
+    {
+      struct cache_block *b = &cache[i];
+      if (b->in_use && b->dirty && (all || b->owner == owner)) 
+        {
+          size_t j;
+
+          for (j = dirty_cnt; j > 0 && dirty[j - 1]->sector > b->sector; j--)
+            dirty[j] = dirty[j - 1];
+          dirty[j] = b;
+          dirty_cnt++;
+          b->use_cnt++;
+        }
+    }
+  lock_release (&cache_lock);
+
+  /* Write them back a run of consecutive sectors at a time. */
+  for (i = 0; i < dirty_cnt; ) 
+    {
+      struct cache_block *run[CLUSTER_SECTORS];
+      size_t cnt = 0;
+      size_t j, k;
+
+      do 
+        {
+          struct cache_block *b = dirty[i++];
+          filesys_lock (&b->lock, FS_LOCK_CACHE);
+          run[cnt++] = b;
+        }
+      while (i < dirty_cnt && cnt < CLUSTER_SECTORS
+             && dirty[i]->sector == dirty[i - 1]->sector + 1);
+
+      /* Blocks that changed hands while we waited stay dirty. */
+      for (j = k = 0; j < cnt; j++)
+        if (all || run[j]->owner == owner)
+          run[k++] = run[j];
+        else
+          release (run[j]);
+      cnt = k;
+      write_back (run, cnt);
+      for (j = 0; j < cnt; j++)
+        release (run[j]);
+    }
+}
+
+/* Writes back every dirty block that belongs to the file whose
+   inode is in sector OWNER, in ascending sector order. */
+void
+cache_flush (disk_sector_t owner) 
+{
+  flush (false, owner);
+}
+
+/* Writes back every dirty block, in ascending sector order. */
+void
+cache_flush_all (void) 
+{
+  flush (true, 0);
+}
@@ -0,0 +1,23 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/disk.h"
+
+void cache_init (void);
+void cache_print_stats (void);
+
+void cache_read (disk_sector_t, void *);
+void cache_read_at (disk_sector_t, void *, int ofs, int size);
+void cache_write (disk_sector_t, const void *, disk_sector_t owner);
+void cache_write_at (disk_sector_t, const void *, int ofs, int size,
+                     disk_sector_t owner);
+void cache_write_fresh_at (disk_sector_t, const void *, int ofs, int size,
+                           disk_sector_t owner);
+void cache_zero (disk_sector_t, size_t cnt, disk_sector_t owner);
+void cache_log (disk_sector_t, const void *);
+void cache_log_at (disk_sector_t, const void *, int ofs, int size);
+void cache_flush (disk_sector_t owner);
+void cache_flush_all (void);
+
+#endif /* filesys/cache.h */
@@ -1,7 +1,10 @@
 #include "filesys/directory.h"
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include <hash.h>
+#include <round.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -11,6 +14,7 @@ struct dir
   {
     struct inode *inode;                /* Backing store. */
     off_t pos;                          /* Current position. */
+    size_t bucket_cnt;                  /* Hash buckets, 0 if linear. */
   };
 
 /* A single directory entry. */
@@ -21,12 +25,102 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Directories come in two on-disk formats.
+
+   A linear directory is a plain array of struct dir_entry, as
+   in the original Pintos.  It is only created for directories
+   small enough to fit in a single sector, where a scan is as
+   cheap as anything else, and grows by appending entries.
+
+   A hashed directory is an array of sectors ("buckets"), each a
+   struct dir_bucket.  An entry lives in the bucket selected by
+   hash_string() of its name, or, if that bucket is full, in the
+   next bucket with room (wrapping around).  Looking up or adding
+   a name therefore normally reads only one sector.  Each bucket
+   counts the entries that hash to it but overflowed elsewhere,
+   so that a lookup that misses knows when it may stop probing. */
+
+/* Identifies a hashed directory bucket.
+   Linear directories start with the inode sector of their first
+   entry instead, and no disk Pintos uses is anywhere near large
+   enough for that to look like this value. */
+#define DIR_BUCKET_MAGIC 0x48534944
+
+/* Number of entries in a hashed directory bucket. */
+#define DIR_BUCKET_ENTRIES 25
+
+/* A hashed directory bucket.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct dir_bucket
+  {
+    unsigned magic;                     /* DIR_BUCKET_MAGIC. */
+    uint16_t used_cnt;                  /* Number of entries in use. */
+    uint8_t free_hint;                  /* Probably-free slot index. */
+    uint8_t unused;                     /* Not used. */
+    uint32_t overflow_cnt;              /* Entries homed here, stored later. */
+    struct dir_entry entries[DIR_BUCKET_ENTRIES];
+  };
+
+/* Returns the bucket in which NAME belongs in DIR. */
+static size_t
+bucket_home (const struct dir *dir, const char *name) 
+{
+  return hash_string (name) % dir->bucket_cnt;
+}
+
+/* Reads bucket IDX of DIR into B.
+   Returns true if successful, false on failure. */
+static bool
+read_bucket (const struct dir *dir, size_t idx, struct dir_bucket *b) 
+{
+  return (inode_read_at (dir->inode, b, sizeof *b, idx * sizeof *b)
+          == sizeof *b);
+}
+
+/* Writes B to bucket IDX of DIR.
+   Returns true if successful, false on failure. */
+static bool
+write_bucket (struct dir *dir, size_t idx, const struct dir_bucket *b) 
+{
+  return (inode_write_at (dir->inode, b, sizeof *b, idx * sizeof *b)
+          == sizeof *b);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR.  Returns true if successful, false on failure.
+   Directories that need more than one sector of entries are
+   created in hashed format. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) 
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_bucket *b;
+  struct dir *dir;
+  size_t bucket_cnt, i;
+  bool success;
+
+  ASSERT (sizeof (struct dir_bucket) == DISK_SECTOR_SIZE);
+
+  if (entry_cnt * sizeof (struct dir_entry) <= DISK_SECTOR_SIZE)
+    return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+
+  bucket_cnt = DIV_ROUND_UP (entry_cnt, DIR_BUCKET_ENTRIES);
+  if (!inode_create (sector, bucket_cnt * sizeof *b))
+    return false;
+
+  /* Stamp every bucket so that dir_open() recognizes the
+     format. */
+  b = calloc (1, sizeof *b);
+  dir = dir_open (inode_open (sector));
+  success = b != NULL && dir != NULL;
+  if (success) 
+    {
+      b->magic = DIR_BUCKET_MAGIC;
+      for (i = 0; i < bucket_cnt && success; i++)
+        success = write_bucket (dir, i, b);
+    }
+  dir_close (dir);
+  free (b);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -37,8 +131,17 @@ dir_open (struct inode *inode)
   struct dir *dir = calloc (1, sizeof *dir);
   if (inode != NULL && dir != NULL)
     {
+      off_t length = inode_length (inode);
+      unsigned magic;
+
+      inode_journal_data (inode);
       dir->inode = inode;
       dir->pos = 0;
+      dir->bucket_cnt = 0;
+      if (length >= DISK_SECTOR_SIZE && length % DISK_SECTOR_SIZE == 0
+          && inode_read_at (inode, &magic, sizeof magic, 0) == sizeof magic
+          && magic == DIR_BUCKET_MAGIC)
+        dir->bucket_cnt = length / DISK_SECTOR_SIZE;
       return dir;
     }
   else
@@ -83,7 +186,7 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
+/* Searches linear directory DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
@@ -111,6 +214,53 @@ lookup (const struct dir *dir, const char *name,
   return false;
 }
 
+/* Searches hashed directory DIR for a file with the given NAME,
+   using B as scratch space.
+   If successful, returns true, leaves the bucket holding the
+   entry in B and sets *IDXP and *SLOTP to its bucket and slot
+   index.  Otherwise, returns false. */
+static bool
+lookup_hashed (const struct dir *dir, const char *name,
+               struct dir_bucket *b, size_t *idxp, size_t *slotp) 
+{
+  size_t home = bucket_home (dir, name);
+  uint32_t overflow_left = 0;
+  size_t i;
+
+  for (i = 0; i < dir->bucket_cnt; i++) 
+    {
+      size_t idx = (home + i) % dir->bucket_cnt;
+      size_t slot;
+
+      if (!read_bucket (dir, idx, b))
+        return false;
+      if (i == 0)
+        overflow_left = b->overflow_cnt;
+
+      for (slot = 0; slot < DIR_BUCKET_ENTRIES; slot++) 
+        {
+          struct dir_entry *e = &b->entries[slot];
+          if (!e->in_use)
+            continue;
+          if (!strcmp (name, e->name)) 
+            {
+              *idxp = idx;
+              *slotp = slot;
+              return true;
+            }
+          if (i > 0 && overflow_left > 0
+              && bucket_home (dir, e->name) == home)
+            overflow_left--;
+        }
+
+      /* Stop once every overflowed entry from the home bucket has
+         been accounted for. */
+      if (overflow_left == 0)
+        break;
+    }
+  return false;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -124,14 +274,74 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
+  *inode = NULL;
+  inode_lock_dir (dir->inode, false);
+  if (dir->bucket_cnt > 0) 
+    {
+      struct dir_bucket *b = malloc (sizeof *b);
+      size_t idx, slot;
+
+      if (b != NULL && lookup_hashed (dir, name, b, &idx, &slot))
+        *inode = inode_open (b->entries[slot].inode_sector);
+      free (b);
+    }
+  else if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  inode_unlock_dir (dir->inode, false);
 
   return *inode != NULL;
 }
 
+/* Adds a file named NAME to hashed directory DIR, using B as
+   scratch space.  NAME must be valid and not already present.
+   Returns true if successful, false if DIR is full or a disk
+   error occurs. */
+static bool
+add_hashed (struct dir *dir, const char *name, disk_sector_t inode_sector,
+            struct dir_bucket *b) 
+{
+  size_t home = bucket_home (dir, name);
+  size_t i;
+
+  for (i = 0; i < dir->bucket_cnt; i++) 
+    {
+      size_t idx = (home + i) % dir->bucket_cnt;
+      struct dir_entry *e;
+      size_t slot;
+
+      if (!read_bucket (dir, idx, b))
+        return false;
+      if (b->used_cnt >= DIR_BUCKET_ENTRIES)
+        continue;
+
+      /* Try the hint first, then scan for a free slot. */
+      slot = b->free_hint;
+      if (slot >= DIR_BUCKET_ENTRIES || b->entries[slot].in_use)
+        for (slot = 0; b->entries[slot].in_use; slot++)
+          continue;
+
+      e = &b->entries[slot];
+      e->in_use = true;
+      strlcpy (e->name, name, sizeof e->name);
+      e->inode_sector = inode_sector;
+      b->used_cnt++;
+      b->free_hint = slot + 1;
+      if (!write_bucket (dir, idx, b))
+        return false;
+
+      /* Record the overflow in the home bucket. */
+      if (i > 0) 
+        {
+          if (!read_bucket (dir, home, b))
+            return false;
+          b->overflow_cnt++;
+          return write_bucket (dir, home, b);
+        }
+      return true;
+    }
+  return false;
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
@@ -152,6 +362,19 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  inode_lock_dir (dir->inode, true);
+  if (dir->bucket_cnt > 0) 
+    {
+      struct dir_bucket *b = malloc (sizeof *b);
+      size_t idx, slot;
+
+      success = (b != NULL
+                 && !lookup_hashed (dir, name, b, &idx, &slot)
+                 && add_hashed (dir, name, inode_sector, b));
+      free (b);
+      goto done;
+    }
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
@@ -175,9 +398,51 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
  done:
+  inode_unlock_dir (dir->inode, true);
   return success;
 }
 
+/* Returns the most journal credits that adding an entry to DIR
+   with dir_add() can use. */
+size_t
+dir_add_credits (struct dir *dir) 
+{
+  /* The bucket that gets the entry and its home bucket. */
+  if (dir->bucket_cnt > 0)
+    return 2;
+
+  /* At worst, an entry appended to the end. */
+  return inode_write_credits (dir->inode, sizeof (struct dir_entry),
+                              inode_length (dir->inode));
+}
+
+/* Erases NAME's entry from hashed directory DIR.  B must hold
+   bucket IDX, in which lookup_hashed() found the entry at SLOT;
+   it is then reused as scratch space.
+   Returns true if successful, false if a disk error occurs. */
+static bool
+erase_hashed (struct dir *dir, const char *name, struct dir_bucket *b,
+              size_t idx, size_t slot) 
+{
+  size_t home = bucket_home (dir, name);
+
+  b->entries[slot].in_use = false;
+  b->used_cnt--;
+  b->free_hint = slot;
+  if (!write_bucket (dir, idx, b))
+    return false;
+
+  if (idx != home) 
+    {
+      if (!read_bucket (dir, home, b))
+        return false;
+      ASSERT (b->overflow_cnt > 0);
+      b->overflow_cnt--;
+      return write_bucket (dir, home, b);
+    }
+  return true;
+}
+
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
    which occurs only if there is no file with the given NAME. */
@@ -192,6 +457,23 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock_dir (dir->inode, true);
+  if (dir->bucket_cnt > 0) 
+    {
+      struct dir_bucket *b = malloc (sizeof *b);
+      size_t idx, slot;
+
+      if (b != NULL && lookup_hashed (dir, name, b, &idx, &slot)
+          && (inode = inode_open (b->entries[slot].inode_sector)) != NULL
+          && erase_hashed (dir, name, b, idx, slot)) 
+        {
+          inode_remove (inode);
+          success = true;
+        }
+      free (b);
+      goto done;
+    }
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -211,15 +493,15 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
  done:
+  inode_unlock_dir (dir->inode, true);
   inode_close (inode);
   return success;
 }
 
-/* Reads the next directory entry in DIR and stores the name in
-   NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
-bool
-dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+/* Reads the next entry of linear directory DIR, as
+   dir_readdir(). */
+static bool
+readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
 
@@ -234,3 +516,139 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
     }
   return false;
 }
+
+/* Reads the next entry of hashed directory DIR, as
+   dir_readdir().  DIR's position counts entry slots across all
+   of the buckets. */
+static bool
+readdir_hashed (struct dir *dir, char name[NAME_MAX + 1])
+{
+  struct dir_bucket *b = malloc (sizeof *b);
+  bool found = false;
+
+  while (b != NULL && !found
+         && (size_t) dir->pos < dir->bucket_cnt * DIR_BUCKET_ENTRIES) 
+    {
+      size_t idx = dir->pos / DIR_BUCKET_ENTRIES;
+      size_t slot = dir->pos % DIR_BUCKET_ENTRIES;
+
+      if (!read_bucket (dir, idx, b))
+        break;
+      for (; slot < DIR_BUCKET_ENTRIES && !found; slot++) 
+        if (b->entries[slot].in_use) 
+          {
+            strlcpy (name, b->entries[slot].name, NAME_MAX + 1);
+            found = true;
+          }
+      dir->pos = idx * DIR_BUCKET_ENTRIES + slot;
+    }
+  free (b);
+  return found;
+}
+
+/* Reads the next directory entry in DIR and stores the name in
+   NAME.  Returns true if successful, false if the directory
+   contains no more entries. */
+bool
+dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  bool found;
+
+  inode_lock_dir (dir->inode, false);
+  if (dir->bucket_cnt > 0)
+    found = readdir_hashed (dir, name);
+  else
+    found = readdir (dir, name);
+  inode_unlock_dir (dir->inode, false);
+  return found;
+}
+
+/* Stores the name and inode number of directory entry E in D. */
+static void
+fill_dirent (struct dirent *d, const struct dir_entry *e) 
+{
+  d->d_ino = e->inode_sector;
+  strlcpy (d->d_name, e->name, sizeof d->d_name);
+}
+
+/* Reads up to CNT entries of linear directory DIR into ENTS, as
+   dir_readdir_many(), a sector's worth of entries at a time. */
+static size_t
+readdir_many (struct dir *dir, struct dirent *ents, size_t cnt) 
+{
+  enum { ENTRY_CNT = DISK_SECTOR_SIZE / sizeof (struct dir_entry) };
+  struct dir_entry *e = malloc (ENTRY_CNT * sizeof *e);
+  size_t n = 0;
+
+  while (e != NULL && n < cnt) 
+    {
+      off_t size = inode_read_at (dir->inode, e, ENTRY_CNT * sizeof *e,
+                                  dir->pos);
+      size_t read_cnt = size / sizeof *e;
+      size_t i;
+
+      if (read_cnt == 0)
+        break;
+      for (i = 0; i < read_cnt && n < cnt; i++)
+        if (e[i].in_use)
+          fill_dirent (&ents[n++], &e[i]);
+      dir->pos += i * sizeof *e;
+    }
+  free (e);
+  return n;
+}
+
+/* Reads up to CNT entries of hashed directory DIR into ENTS, as
+   dir_readdir_many(), a bucket at a time. */
+static size_t
+readdir_many_hashed (struct dir *dir, struct dirent *ents, size_t cnt) 
+{
+  struct dir_bucket *b = malloc (sizeof *b);
+  size_t n = 0;
+
+  while (b != NULL && n < cnt
+         && (size_t) dir->pos < dir->bucket_cnt * DIR_BUCKET_ENTRIES) 
+    {
+      size_t idx = dir->pos / DIR_BUCKET_ENTRIES;
+      size_t slot = dir->pos % DIR_BUCKET_ENTRIES;
+
+      if (!read_bucket (dir, idx, b))
+        break;
+      for (; slot < DIR_BUCKET_ENTRIES && n < cnt; slot++) 
+        if (b->entries[slot].in_use) 
+          fill_dirent (&ents[n++], &b->entries[slot]);
+      dir->pos = idx * DIR_BUCKET_ENTRIES + slot;
+    }
+  free (b);
+  return n;
+}
+
+/* Reads up to CNT entries from DIR, starting at its current
+   position, into ENTS, with each entry's name, inode number,
+   type and size.  Returns the number of entries read, which is 0
+   once the directory has no more.  Unlike dir_readdir(), this
+   reads each directory sector only once for all of the entries
+   it holds.  Each entry's inode is read to find its size. */
+size_t
+dir_readdir_many (struct dir *dir, struct dirent *ents, size_t cnt) 
+{
+  size_t n;
+  size_t i;
+
+  inode_lock_dir (dir->inode, false);
+  if (dir->bucket_cnt > 0)
+    n = readdir_many_hashed (dir, ents, cnt);
+  else
+    n = readdir_many (dir, ents, cnt);
+  inode_unlock_dir (dir->inode, false);
+
+  /* Only the root directory exists, so every entry is a file. */
+  for (i = 0; i < n; i++) 
+    {
+      struct inode *inode = inode_open (ents[i].d_ino);
+      ents[i].d_type = DT_REG;
+      ents[i].d_size = inode != NULL ? inode_length (inode) : 0;
+      inode_close (inode);
+    }
+  return n;
+}
@@ -12,6 +12,11 @@
 #define NAME_MAX 14
 
 struct inode;
+struct dirent;
+
+/* Most journal credits that dir_remove() can use: the sector or
+   two holding the entry, or its bucket and its home bucket. */
+#define DIR_REMOVE_CREDITS 2
 
 /* Opening and closing directories. */
 bool dir_create (disk_sector_t sector, size_t entry_cnt);
@@ -24,7 +29,9 @@ struct inode *dir_get_inode (struct dir *);
 /* Reading and writing. */
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, disk_sector_t);
+size_t dir_add_credits (struct dir *);
 bool dir_remove (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+size_t dir_readdir_many (struct dir *, struct dirent *, size_t cnt);
 
 #endif /* filesys/directory.h */
@@ -2,6 +2,8 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* An open file. */
 struct file 
@@ -87,9 +89,7 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the file cannot be extended.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +102,7 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the file cannot be extended.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -113,6 +111,55 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, to DST, starting at its current position, and
+   advances both positions past the bytes copied.  The data
+   passes from SRC's sectors to DST's through the buffer cache
+   and a kernel page, never through user memory.
+   Returns the number of bytes copied, which may be less than
+   SIZE if end of SRC is reached, DST cannot be extended, or
+   memory cannot be allocated. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size) 
+{
+  uint8_t *bounce = palloc_get_page (0);
+  off_t bytes_copied = 0;
+
+  if (bounce == NULL)
+    return 0;
+  while (size > 0) 
+    {
+      off_t chunk_size = size < PGSIZE ? size : PGSIZE;
+      off_t bytes_read = file_read (src, bounce, chunk_size);
+      off_t bytes_written = file_write (dst, bounce, bytes_read);
+
+      bytes_copied += bytes_written;
+      size -= bytes_written;
+      if (bytes_written < chunk_size) 
+        {
+          /* Leave SRC just past the last byte written. */
+          src->pos -= bytes_read - bytes_written;
+          break;
+        }
+    }
+  palloc_free_page (bounce);
+
+  return bytes_copied;
+}
+
+/* Reserves contiguous disk space for the first SIZE bytes of
+   FILE, so that later writes up to SIZE bytes land in sequential
+   sectors and do no allocation.  FILE's length is unchanged
+   unless ZERO is true, in which case FILE is also extended to
+   SIZE bytes and every byte of it not yet written is zeroed on
+   disk.  Returns true if successful, false on failure. */
+bool
+file_reserve (struct file *file, off_t size, bool zero) 
+{
+  return (inode_reserve (file->inode, size)
+          && (!zero || inode_zero_fill (file->inode, size)));
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -148,6 +195,14 @@ file_length (struct file *file)
   return inode_length (file->inode);
 }
 
+/* Writes FILE's data and metadata to disk. */
+void
+file_sync (struct file *file) 
+{
+  ASSERT (file != NULL);
+  inode_sync (file->inode);
+}
+
 /* Sets the current position in FILE to NEW_POS bytes from the
    start of the file. */
 void
@@ -2,16 +2,31 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 #include "devices/disk.h"
+#include "threads/interrupt.h"
+
+/* Number of entries the root directory is formatted to hold.
+   This is large enough that the root uses the hashed directory
+   format. */
+#define ROOT_DIR_ENTRIES 200
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
 
+/* Lock contention statistics, indexed by enum fs_lock_type. */
+static const char *lock_type_names[FS_LOCK_TYPE_CNT] =
+  {"inode", "directory", "free map", "cache", "journal"};
+static long long lock_acquire_cnt[FS_LOCK_TYPE_CNT];
+static long long lock_contended_cnt[FS_LOCK_TYPE_CNT];
+
 static void do_format (void);
+static void count_acquire (enum fs_lock_type, bool contended);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -22,7 +37,9 @@ filesys_init (bool format)
   if (filesys_disk == NULL)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+  cache_init ();
   inode_init ();
+  journal_init (format);
   free_map_init ();
 
   if (format) 
@@ -36,7 +53,67 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  filesys_sync ();
   free_map_close ();
+  journal_checkpoint ();
+}
+
+/* Prints file system statistics. */
+void
+filesys_print_stats (void) 
+{
+  int i;
+
+  for (i = 0; i < FS_LOCK_TYPE_CNT; i++)
+    printf ("Filesys %s locks: %lld acquired, %lld contended\n",
+            lock_type_names[i], lock_acquire_cnt[i], lock_contended_cnt[i]);
+  cache_print_stats ();
+  journal_print_stats ();
+}
+
+/* Acquires LOCK, a file system lock of the given TYPE, and
+   records whether it had to wait for another thread. */
+void
+filesys_lock (struct lock *lock, enum fs_lock_type type) 
+{
+  bool contended = !lock_try_acquire (lock);
+
+  if (contended)
+    lock_acquire (lock);
+  count_acquire (type, contended);
+}
+
+/* Acquires RW, a file system readers-writer lock of the given
+   TYPE, for writing if WRITE is true or for reading otherwise,
+   and records whether it had to wait for another thread. */
+void
+filesys_rwlock (struct rwlock *rw, bool write, enum fs_lock_type type) 
+{
+  bool contended = !(write
+                     ? rwlock_try_acquire_write (rw)
+                     : rwlock_try_acquire_read (rw));
+
+  if (contended) 
+    {
+      if (write)
+        rwlock_acquire_write (rw);
+      else
+        rwlock_acquire_read (rw);
+    }
+  count_acquire (type, contended);
+}
+
+/* Records an acquisition of a lock of the given TYPE, which had
+   to wait if CONTENDED is true.  The counters are shared by every
+   lock of a type, so they are updated with interrupts off. */
+static void
+count_acquire (enum fs_lock_type type, bool contended) 
+{
+  enum intr_level old_level = intr_disable ();
+  lock_acquire_cnt[type]++;
+  if (contended)
+    lock_contended_cnt[type]++;
+  intr_set_level (old_level);
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -48,12 +125,24 @@ filesys_create (const char *name, off_t initial_size)
 {
   disk_sector_t inode_sector = 0;
   struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
-  if (!success && inode_sector != 0) 
-    free_map_release (inode_sector, 1);
+  bool success;
+
+  /* Credits for allocating the inode's sector, the inode and its
+     data, and the directory entry.  A file too large to allocate
+     in one transaction cannot be created. */
+  success = (dir != NULL
+             && journal_begin (free_map_credits (1)
+                               + inode_create_credits (initial_size)
+                               + dir_add_credits (dir)));
+  if (success) 
+    {
+      success = (free_map_allocate (1, &inode_sector)
+                 && inode_create (inode_sector, initial_size)
+                 && dir_add (dir, name, inode_sector));
+      if (!success && inode_sector != 0) 
+        free_map_release (inode_sector, 1);
+      journal_end ();
+    }
   dir_close (dir);
 
   return success;
@@ -77,6 +166,17 @@ filesys_open (const char *name)
   return file_open (inode);
 }
 
+/* Opens the directory with the given NAME, which must be "/" or
+   "." since the root is the only directory.  Returns the new
+   directory if successful or a null pointer otherwise. */
+struct dir *
+filesys_open_dir (const char *name) 
+{
+  if (strcmp (name, "/") && strcmp (name, "."))
+    return NULL;
+  return dir_open_root ();
+}
+
 /* Deletes the file named NAME.
    Returns true if successful, false on failure.
    Fails if no file named NAME exists,
@@ -85,20 +185,42 @@ bool
 filesys_remove (const char *name) 
 {
   struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct inode *inode = NULL;
+  bool success = false;
+
+  /* Keep the file open until the operation has ended, so that
+     its sectors, whose release may take several operations, are
+     not released inside this one. */
+  if (dir != NULL && dir_lookup (dir, name, &inode)
+      && journal_begin (DIR_REMOVE_CREDITS)) 
+    {
+      success = dir_remove (dir, name);
+      journal_end ();
+    }
   dir_close (dir); 
+  inode_close (inode);
 
   return success;
 }
 
+/* Writes all dirty file data to disk, in sector order, and
+   commits the journal. */
+void
+filesys_sync (void) 
+{
+  cache_flush_all ();
+  journal_commit ();
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, ROOT_DIR_ENTRIES))
     PANIC ("root directory creation failed");
   free_map_close ();
+  journal_checkpoint ();
   printf ("done.\n");
 }
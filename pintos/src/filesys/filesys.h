@@ -3,18 +3,38 @@
 
 #include <stdbool.h>
 #include "filesys/off_t.h"
+#include "threads/synch.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
 
+/* First sector of the journal (see filesys/journal.c). */
+#define JOURNAL_SECTOR 2
+
 /* Disk used for file system. */
 extern struct disk *filesys_disk;
 
+/* Kinds of file system locks, for contention statistics. */
+enum fs_lock_type
+  {
+    FS_LOCK_INODE,              /* Per-inode data locks. */
+    FS_LOCK_DIR,                /* Per-directory entry locks. */
+    FS_LOCK_FREE_MAP,           /* Free map lock. */
+    FS_LOCK_CACHE,              /* Buffer cache block locks. */
+    FS_LOCK_JOURNAL,            /* Journal lock. */
+    FS_LOCK_TYPE_CNT
+  };
+
 void filesys_init (bool format);
 void filesys_done (void);
+void filesys_print_stats (void);
+void filesys_lock (struct lock *, enum fs_lock_type);
+void filesys_rwlock (struct rwlock *, bool write, enum fs_lock_type);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
+struct dir *filesys_open_dir (const char *name);
 bool filesys_remove (const char *name);
+void filesys_sync (void);
 
 #endif /* filesys/filesys.h */
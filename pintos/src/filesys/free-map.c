@@ -1,22 +1,75 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <limits.h>
+#include <round.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Protects the free map. */
+
+/* Only the sectors of the free map file that a change affects
+   are rewritten.  DIRTY has one bit per sector of the free map
+   file, set when that part of the free map changes.  The free
+   map file is journaled, so writing those sectors after each
+   allocation or release only logs them in memory, as part of
+   the caller's transaction; they reach disk when the journal
+   commits. */
+static struct bitmap *dirty;
+
+static void write_dirty (void);
+
+/* Number of free map bits stored in a sector of its file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * CHAR_BIT)
+
+/* The whole free map is kept in kernel memory, so the file
+   system uses at most the first FREE_MAP_MAX_SECTORS sectors
+   (1 GB) of its disk, for a 256 kB free map.  The limit must not
+   change once a disk is formatted, because the size of the free
+   map file depends on it; utils/pintos-fs.h mirrors it. */
+#define FREE_MAP_MAX_SECTORS (2 * 1024 * 1024)
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
-  free_map = bitmap_create (disk_size (filesys_disk));
+  disk_sector_t size = disk_size (filesys_disk);
+
+  lock_init (&free_map_lock);
+  if (size > FREE_MAP_MAX_SECTORS) 
+    {
+      printf ("filesys: using only the first %d MB of the disk\n",
+              FREE_MAP_MAX_SECTORS / 2048);
+      size = FREE_MAP_MAX_SECTORS;
+    }
+  free_map = bitmap_create (size);
   if (free_map == NULL)
     PANIC ("bitmap creation failed--disk is too large");
+  dirty = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                       DISK_SECTOR_SIZE));
+  if (dirty == NULL)
+    PANIC ("bitmap creation failed--disk is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+}
+
+/* Records that the free map bits for the CNT sectors starting at
+   SECTOR have changed.  The caller must hold free_map_lock. */
+static void
+mark_dirty (disk_sector_t sector, size_t cnt) 
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  if (cnt > 0)
+    bitmap_set_multiple (dirty, first, last - first + 1, true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -26,14 +79,16 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
 {
-  disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  disk_sector_t sector;
+
+  filesys_lock (&free_map_lock, FS_LOCK_FREE_MAP);
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  if (sector != BITMAP_ERROR) 
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      mark_dirty (sector, cnt);
+      write_dirty ();
     }
+  lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
@@ -43,9 +98,57 @@ free_map_allocate (size_t cnt, disk_sector_t *sectorp)
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
+  filesys_lock (&free_map_lock, FS_LOCK_FREE_MAP);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  write_dirty ();
+  lock_release (&free_map_lock);
+}
+
+/* Returns the most sectors of the free map file that allocating
+   or releasing a run of CNT sectors can change, for reserving
+   journal credits. */
+size_t
+free_map_credits (size_t cnt) 
+{
+  return cnt > 0 ? DIV_ROUND_UP (cnt - 1, BITS_PER_SECTOR) + 1 : 0;
+}
+
+/* Writes the sectors of the free map file that hold changes not
+   yet written.  Each run of adjacent changed sectors is written
+   with a single write. */
+void
+free_map_flush (void) 
+{
+  filesys_lock (&free_map_lock, FS_LOCK_FREE_MAP);
+  write_dirty ();
+  lock_release (&free_map_lock);
+}
+
+/* Does the work of free_map_flush().  The caller must hold
+   free_map_lock.  Does nothing until the free map file is
+   open. */
+static void
+write_dirty (void) 
+{
+  size_t start = 0;
+
+  while (free_map_file != NULL
+         && (start = bitmap_scan (dirty, start, 1, true)) != BITMAP_ERROR)
+    {
+      size_t cnt = 1;
+      while (start + cnt < bitmap_size (dirty)
+             && bitmap_test (dirty, start + cnt))
+        cnt++;
+
+      if (!bitmap_write_partial (free_map, free_map_file,
+                                 start * DISK_SECTOR_SIZE,
+                                 cnt * DISK_SECTOR_SIZE))
+        break;
+      bitmap_set_multiple (dirty, start, cnt, false);
+      start += cnt;
+    }
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -55,6 +158,7 @@ free_map_open (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_journal_data (file_get_inode (free_map_file));
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
 }
@@ -63,7 +167,9 @@ free_map_open (void)
 void
 free_map_close (void) 
 {
+  free_map_flush ();
   file_close (free_map_file);
+  free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -79,6 +185,8 @@ free_map_create (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_journal_data (file_get_inode (free_map_file));
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty, false);
 }
@@ -1,23 +1,47 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Bytes of file data that fit in the inode sector itself. */
+#define INODE_INLINE_SIZE 488
+
+/* Inode flags. */
+#define INODE_INLINE 0x1                /* Data is stored in the inode. */
+
 /* On-disk inode.
-   Must be exactly DISK_SECTOR_SIZE bytes long. */
+   Must be exactly DISK_SECTOR_SIZE bytes long.
+
+   A file of up to INODE_INLINE_SIZE bytes keeps its data in
+   INLINE_DATA, so that reading the inode also reads the data.
+   When it grows past that, its data moves to a run of
+   SECTOR_CNT contiguous sectors starting at START, and a run
+   that becomes too small is replaced by one twice as large.
+
+   Data sectors are not initialized when they are allocated.
+   Only the first VALID_LENGTH bytes have ever been written; the
+   rest of the file reads as zeros regardless of what its sectors
+   hold, and is zeroed on disk only when a write skips past it.
+   Inline data is always valid. */
 struct inode_disk
   {
     disk_sector_t start;                /* First data sector. */
+    uint32_t sector_cnt;                /* Number of data sectors. */
     off_t length;                       /* File size in bytes. */
+    off_t valid_length;                 /* Bytes of data written so far. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t flags;                     /* INODE_* flags. */
+    uint8_t inline_data[INODE_INLINE_SIZE]; /* Data if INODE_INLINE. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -31,42 +55,99 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     disk_sector_t sector;               /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
+
+    struct rwlock dir_rw;               /* Held by directory operations. */
+
+    /* Protected by LOCK, which may be acquired while holding RW
+       but never the other way around. */
+    struct lock lock;                   /* Protects the members below. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    bool journal_data;                  /* Journal data, not just inode? */
+
+    /* Protected by RW. */
+    struct rwlock rw;                   /* Held while reading or writing data. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Returns true if INODE's data is stored in its inode sector. */
+static inline bool
+is_inline (const struct inode *inode) 
+{
+  return (inode->data.flags & INODE_INLINE) != 0;
+}
+
 /* Returns the disk sector that contains byte offset POS within
-   INODE.
+   INODE, which must not be inline.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static disk_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
+  ASSERT (!is_inline (inode));
   if (pos < inode->data.length)
     return inode->data.start + pos / DISK_SECTOR_SIZE;
   else
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Returns the disk user charged for I/O on INODE's data. */
+static enum disk_user
+data_user (const struct inode *inode) 
+{
+  if (!inode->journal_data)
+    return DISK_USER_DATA;
+  else if (inode->sector == FREE_MAP_SECTOR)
+    return DISK_USER_FREE_MAP;
+  else
+    return DISK_USER_DIR;
+}
+
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'.
+   OPEN_INODES_LOCK protects the table and every inode's
+   open_cnt.  It is never held across disk I/O. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  lock_init (&open_inodes_lock);
+}
+
+/* Returns a hash value for the inode that contains E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+/* Returns true if inode A precedes inode B. */
+static bool
+inode_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct inode *a = hash_entry (a_, struct inode, elem);
+  const struct inode *b = hash_entry (b_, struct inode, elem);
+  return a->sector < b->sector;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   disk.
+   disk.  Small files are created inline.  For larger ones, the
+   data sectors are allocated but not written; they read as zeros
+   until they are written.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
@@ -84,20 +165,19 @@ inode_create (disk_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
+      if (length <= INODE_INLINE_SIZE)
         {
-          disk_write (filesys_disk, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[DISK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                disk_write (filesys_disk, disk_inode->start + i, zeros); 
-            }
+          disk_inode->flags = INODE_INLINE;
+          disk_inode->valid_length = length;
+        }
+      else
+        disk_inode->sector_cnt = bytes_to_sectors (length);
+      if (disk_inode->sector_cnt == 0
+          || free_map_allocate (disk_inode->sector_cnt, &disk_inode->start))
+        {
+          cache_log (sector, disk_inode);
           success = true; 
         } 
       free (disk_inode);
@@ -105,39 +185,70 @@ inode_create (disk_sector_t sector, off_t length)
   return success;
 }
 
+/* Returns the most journal credits that inode_create() can use
+   to create an inode LENGTH bytes long. */
+size_t
+inode_create_credits (off_t length) 
+{
+  return 1 + (length > INODE_INLINE_SIZE
+              ? free_map_credits (bytes_to_sectors (length)) : 0);
+}
+
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
    Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) 
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
-
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  enum disk_user old_user;
+
+  /* Check whether this inode is already open.  If it is, its
+     opener may still be reading it from disk, so wait for its
+     lock before handing it out. */
+  key.sector = sector;
+  lock_acquire (&open_inodes_lock);
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL) 
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+
+      lock_acquire (&inode->lock);
+      lock_release (&inode->lock);
+      return inode; 
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  Publish the inode before reading it, holding
+     its lock, so that the disk read does not hold up opens of
+     other inodes. */
   inode->sector = sector;
   inode->open_cnt = 1;
+  rwlock_init (&inode->rw);
+  rwlock_init (&inode->dir_rw);
+  lock_init (&inode->lock);
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  disk_read (filesys_disk, inode->sector, &inode->data);
+  inode->journal_data = false;
+  lock_acquire (&inode->lock);
+  hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  old_user = disk_set_user (DISK_USER_INODE);
+  cache_read (inode->sector, &inode->data);
+  disk_set_user (old_user);
+  lock_release (&inode->lock);
   return inode;
 }
 
@@ -146,7 +257,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -157,6 +272,41 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Number of data sectors of a removed inode released per
+   journal operation.  A run this long changes at most 17 sectors
+   of the free map. */
+#define RELEASE_CHUNK (64 * 1024)
+
+/* Releases the data sectors of INODE, which has been removed, in
+   chunks of RELEASE_CHUNK, then its inode sector, each in a
+   journal operation of its own.  Its directory entry was erased
+   by an earlier operation, so a crash partway through only
+   leaks the sectors not yet released.  So does being called
+   inside another operation that has no room left, which is the
+   only way journal_begin() can fail here. */
+static void
+release_sectors (struct inode *inode) 
+{
+  struct inode_disk *d = &inode->data;
+  size_t ofs;
+
+  for (ofs = 0; ofs < d->sector_cnt; ofs += RELEASE_CHUNK) 
+    {
+      size_t cnt = d->sector_cnt - ofs;
+      if (cnt > RELEASE_CHUNK)
+        cnt = RELEASE_CHUNK;
+      if (!journal_begin (free_map_credits (cnt)))
+        return;
+      free_map_release (d->start + ofs, cnt);
+      journal_end ();
+    }
+  if (journal_begin (free_map_credits (1))) 
+    {
+      free_map_release (inode->sector, 1);
+      journal_end ();
+    }
+}
+
 /* Closes INODE and writes it to disk.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
@@ -168,21 +318,22 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
+  lock_acquire (&open_inodes_lock);
   if (--inode->open_cnt == 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
+      /* Remove from inode table and release lock.  Nobody else
+         can find the inode now. */
+      hash_delete (&open_inodes, &inode->elem);
+      lock_release (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
-        {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
-        }
+        release_sectors (inode);
 
       free (inode); 
     }
+  else
+    lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -191,7 +342,9 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  lock_acquire (&inode->lock);
   inode->removed = true;
+  lock_release (&inode->lock);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -202,128 +355,458 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  enum disk_user old_user;
 
-  while (size > 0) 
+  filesys_rwlock (&inode->rw, false, FS_LOCK_INODE);
+  old_user = disk_set_user (data_user (inode));
+  if (is_inline (inode)) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
-      int sector_ofs = offset % DISK_SECTOR_SIZE;
+      /* The data came into memory along with the inode. */
+      if (offset < inode->data.length) 
+        {
+          bytes_read = inode->data.length - offset;
+          if (bytes_read > size)
+            bytes_read = size;
+          memcpy (buffer, inode->data.inline_data + offset, bytes_read);
+        }
+    }
+  else
+    while (size > 0) 
+      {
+        /* Disk sector to read, starting byte offset within sector. */
+        disk_sector_t sector_idx = byte_to_sector (inode, offset);
+        int sector_ofs = offset % DISK_SECTOR_SIZE;
+
+        /* Bytes left in inode, bytes left in sector, lesser of the two. */
+        off_t inode_left = inode_length (inode) - offset;
+        int sector_left = DISK_SECTOR_SIZE - sector_ofs;
+        int min_left = inode_left < sector_left ? inode_left : sector_left;
+
+        /* Number of bytes to actually copy out of this sector. */
+        int chunk_size = size < min_left ? size : min_left;
+        int valid_size;
+        if (chunk_size <= 0)
+          break;
+
+        /* Bytes past the valid length have never been written and
+           read as zeros without touching the disk. */
+        valid_size = inode->data.valid_length - offset;
+        if (valid_size < 0)
+          valid_size = 0;
+        else if (valid_size > chunk_size)
+          valid_size = chunk_size;
+        if (valid_size > 0)
+          cache_read_at (sector_idx, buffer + bytes_read,
+                         sector_ofs, valid_size);
+        memset (buffer + bytes_read + valid_size, 0, chunk_size - valid_size);
+      
+        /* Advance. */
+        size -= chunk_size;
+        offset += chunk_size;
+        bytes_read += chunk_size;
+      }
+  disk_set_user (old_user);
+  rwlock_release_read (&inode->rw);
+
+  return bytes_read;
+}
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+/* Writes SIZE bytes from BUFFER at byte offset OFS within
+   SECTOR, one of INODE's data sectors, through the journal if
+   INODE's data is journaled.  FRESH says that SECTOR lies wholly
+   past INODE's valid data, so that the rest of it need not be
+   read from disk. */
+static void
+write_data (struct inode *inode, disk_sector_t sector, const void *buffer,
+            int ofs, int size, bool fresh) 
+{
+  if (inode->journal_data)
+    cache_log_at (sector, buffer, ofs, size);
+  else if (fresh)
+    cache_write_fresh_at (sector, buffer, ofs, size, inode->sector);
+  else
+    cache_write_at (sector, buffer, ofs, size, inode->sector);
+}
 
-      /* Number of bytes to actually copy out of this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+/* Zeros INODE's data from its valid length up to byte offset
+   END, which must not exceed the inode's length, so that the
+   valid length may be advanced to END.  Only the sector holding
+   the end of the valid data needs a partial write; the sectors
+   after it are zeroed in bulk.  The caller must hold INODE's
+   data lock for writing. */
+static void
+zero_gap (struct inode *inode, off_t end) 
+{
+  static const uint8_t zeros[DISK_SECTOR_SIZE];
+  off_t valid = inode->data.valid_length;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
-        {
-          /* Read full sector directly into caller's buffer. */
-          disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-        }
-      else 
+  ASSERT (end <= inode->data.length);
+
+  if (valid < end && valid % DISK_SECTOR_SIZE != 0) 
+    {
+      int sector_ofs = valid % DISK_SECTOR_SIZE;
+      int size = DISK_SECTOR_SIZE - sector_ofs;
+      if (size > end - valid)
+        size = end - valid;
+      write_data (inode, byte_to_sector (inode, valid),
+                  zeros, sector_ofs, size, false);
+      valid += size;
+    }
+  if (valid < end)
+    cache_zero (byte_to_sector (inode, valid),
+                bytes_to_sectors (end) - valid / DISK_SECTOR_SIZE,
+                inode->sector);
+}
+
+/* Returns the most journal credits that moving INODE's data into
+   a run of CNT sectors with relocate() can use. */
+static size_t
+relocate_credits (const struct inode *inode, size_t cnt) 
+{
+  const struct inode_disk *d = &inode->data;
+  size_t credits = (1 + free_map_credits (cnt)
+                    + free_map_credits (d->sector_cnt));
+
+  /* The data of a journaled inode is logged as it is copied. */
+  if (inode->journal_data)
+    credits += is_inline (inode) ? 1 : bytes_to_sectors (d->valid_length);
+  return credits;
+}
+
+/* Moves INODE's data into a newly allocated run of CNT sectors
+   and frees its old run, if any.  Returns true if successful,
+   false if memory or disk allocation fails or the journal
+   operation in progress has too few credits left for the move,
+   in which case INODE is unchanged.  The caller must hold
+   INODE's data lock for writing. */
+static bool
+relocate (struct inode *inode, size_t cnt) 
+{
+  struct inode_disk *d = &inode->data;
+  disk_sector_t old_start = d->start;
+  size_t old_cnt = d->sector_cnt;
+  disk_sector_t start;
+  uint8_t *bounce;
+  size_t i;
+
+  if (relocate_credits (inode, cnt) > journal_credits ())
+    return false;
+
+  bounce = malloc (DISK_SECTOR_SIZE);
+  if (bounce == NULL)
+    return false;
+  if (!free_map_allocate (cnt, &start)) 
+    {
+      free (bounce);
+      return false;
+    }
+
+  /* Copy the valid data. */
+  if (is_inline (inode)) 
+    {
+      if (d->length > 0) 
         {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          disk_read (filesys_disk, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          memset (bounce, 0, DISK_SECTOR_SIZE);
+          memcpy (bounce, d->inline_data, d->length);
+          write_data (inode, start, bounce, 0, DISK_SECTOR_SIZE, false);
         }
-      
-      /* Advance. */
-      size -= chunk_size;
-      offset += chunk_size;
-      bytes_read += chunk_size;
+      memset (d->inline_data, 0, sizeof d->inline_data);
+      d->flags &= ~INODE_INLINE;
     }
+  else
+    for (i = 0; i < bytes_to_sectors (d->valid_length); i++) 
+      {
+        cache_read (old_start + i, bounce);
+        write_data (inode, start + i, bounce, 0, DISK_SECTOR_SIZE, false);
+      }
   free (bounce);
 
-  return bytes_read;
+  /* Point the inode at the new run before freeing the old one. */
+  d->start = start;
+  d->sector_cnt = cnt;
+  cache_log (inode->sector, d);
+  if (old_cnt > 0)
+    free_map_release (old_start, old_cnt);
+  return true;
+}
+
+/* Extends INODE to LENGTH bytes, moving its data out of the
+   inode sector or into a larger run of sectors if it no longer
+   fits.  Returns true if successful, false if allocation fails.
+   The caller must hold INODE's data lock for writing. */
+static bool
+extend (struct inode *inode, off_t length) 
+{
+  struct inode_disk *d = &inode->data;
+  size_t cnt = bytes_to_sectors (length);
+  bool fits = (is_inline (inode)
+               ? length <= INODE_INLINE_SIZE
+               : cnt <= d->sector_cnt);
+
+  /* Ask for twice the old size first, so that a file that keeps
+     growing is moved only a logarithmic number of times, but
+     settle for what is needed. */
+  if (!fits
+      && !(cnt < 2 * d->sector_cnt && relocate (inode, 2 * d->sector_cnt))
+      && !relocate (inode, cnt))
+    return false;
+  d->length = length;
+  if (is_inline (inode))
+    d->valid_length = length;
+  return true;
+}
+
+/* Returns the number of journal credits to reserve for making
+   INODE LENGTH bytes long with extend(), counting its inode
+   sector: enough for the run extend() tries first, or, if that is
+   more than an operation may reserve, for the smallest run that
+   will do.  If even that is too much, reserves only enough for
+   the inode, and extend() will fail.  May be called without
+   INODE's data lock, like write_changes_inode(); relocate()
+   checks the cost again under the lock. */
+static size_t
+extend_credits (const struct inode *inode, off_t length) 
+{
+  const struct inode_disk *d = &inode->data;
+  size_t cnt = bytes_to_sectors (length);
+  size_t credits;
+
+  if (is_inline (inode) ? length <= INODE_INLINE_SIZE : cnt <= d->sector_cnt)
+    return 1;
+  if (cnt < 2 * d->sector_cnt) 
+    {
+      credits = relocate_credits (inode, 2 * d->sector_cnt);
+      if (credits <= JOURNAL_MAX_CREDITS)
+        return credits;
+    }
+  credits = relocate_credits (inode, cnt);
+  return credits <= JOURNAL_MAX_CREDITS ? credits : 1;
+}
+
+/* Returns true if writing SIZE bytes at OFFSET in INODE may
+   change the inode, or allocate sectors for it, so that the write
+   has to be a journal operation.  May be called without INODE's
+   data lock: files never shrink and never move their data back
+   into the inode, so a false answer cannot become wrong before
+   the lock is acquired. */
+static bool
+write_changes_inode (const struct inode *inode, off_t size, off_t offset) 
+{
+  return is_inline (inode) || offset + size > inode->data.valid_length;
+}
+
+/* Returns the number of journal credits to reserve for writing
+   SIZE bytes at OFFSET in INODE with inode_write_at().  A write
+   to a journaled inode logs its data, and also any gap before
+   OFFSET that it zeroes. */
+size_t
+inode_write_credits (const struct inode *inode, off_t size, off_t offset) 
+{
+  size_t credits = extend_credits (inode, offset + size);
+
+  if (inode->journal_data) 
+    {
+      off_t start = (offset < inode->data.valid_length
+                     ? offset : inode->data.valid_length);
+      credits += bytes_to_sectors (offset + size) - start / DISK_SECTOR_SIZE;
+    }
+  return credits;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs.  A write past end of file
+   extends the inode; if there is no room for that, only the bytes
+   that fit within the current length are written. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
-
-  if (inode->deny_write_cnt)
+  enum disk_user old_user;
+  bool dirty = false;
+  bool denied, journaled, in_journal;
+
+  lock_acquire (&inode->lock);
+  denied = inode->deny_write_cnt > 0;
+  journaled = inode->journal_data;
+  lock_release (&inode->lock);
+  if (denied)
     return 0;
 
-  while (size > 0) 
+  /* Journaled inodes are metadata, written only as part of the
+     operation that changes them, which may hold other file
+     system locks. */
+  in_journal = !journaled && write_changes_inode (inode, size, offset);
+  if (in_journal && !journal_begin (inode_write_credits (inode, size, offset)))
+    return 0;
+  filesys_rwlock (&inode->rw, true, FS_LOCK_INODE);
+  old_user = disk_set_user (data_user (inode));
+  if (size > 0 && offset + size > inode->data.length)
+    dirty = extend (inode, offset + size);
+  if (is_inline (inode)) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
-      int sector_ofs = offset % DISK_SECTOR_SIZE;
-
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
-
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
-
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
+      /* Inline data is written along with the inode below. */
+      if (offset < inode->data.length) 
+        {
+          bytes_written = inode->data.length - offset;
+          if (bytes_written > size)
+            bytes_written = size;
+          memcpy (inode->data.inline_data + offset, buffer, bytes_written);
+          dirty = true;
+        }
+    }
+  else
+    {
+      if (size > 0 && offset > inode->data.valid_length
+          && offset < inode->data.length)
+        zero_gap (inode, offset);
+      while (size > 0) 
         {
-          /* Write full sector directly to disk. */
-          disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+          /* Sector to write, starting byte offset within sector. */
+          disk_sector_t sector_idx = byte_to_sector (inode, offset);
+          int sector_ofs = offset % DISK_SECTOR_SIZE;
+
+          /* Bytes left in inode, bytes left in sector, lesser of the two. */
+          off_t inode_left = inode_length (inode) - offset;
+          int sector_left = DISK_SECTOR_SIZE - sector_ofs;
+          int min_left = inode_left < sector_left ? inode_left : sector_left;
+
+          /* Number of bytes to actually write into this sector. */
+          int chunk_size = size < min_left ? size : min_left;
+          if (chunk_size <= 0)
+            break;
+
+          /* A sector that starts past the valid data holds nothing
+             worth reading back in to merge with the write. */
+          write_data (inode, sector_idx, buffer + bytes_written,
+                      sector_ofs, chunk_size,
+                      offset - sector_ofs >= inode->data.valid_length);
+
+          /* Advance. */
+          size -= chunk_size;
+          offset += chunk_size;
+          bytes_written += chunk_size;
         }
-      else 
+      if (offset > inode->data.valid_length) 
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            disk_read (filesys_disk, sector_idx, bounce);
-          else
-            memset (bounce, 0, DISK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          disk_write (filesys_disk, sector_idx, bounce); 
+          inode->data.valid_length = offset;
+          dirty = true;
         }
-
-      /* Advance. */
-      size -= chunk_size;
-      offset += chunk_size;
-      bytes_written += chunk_size;
     }
-  free (bounce);
+  if (dirty)
+    cache_log (inode->sector, &inode->data);
+  disk_set_user (old_user);
+  rwlock_release_write (&inode->rw);
+  if (in_journal)
+    journal_end ();
 
   return bytes_written;
 }
 
+/* Reserves contiguous space for the first LENGTH bytes of
+   INODE's data without changing its length, moving the data to a
+   run of exactly that many sectors if the current one is
+   smaller.  Writes within LENGTH then need no allocation.
+   Returns true if successful, false if writes to INODE are
+   denied or there is no run of free sectors large enough. */
+bool
+inode_reserve (struct inode *inode, off_t length) 
+{
+  bool success;
+
+  /* Fails if the move is too large to commit at once. */
+  if (!journal_begin (relocate_credits (inode, bytes_to_sectors (length))))
+    return false;
+  filesys_rwlock (&inode->rw, true, FS_LOCK_INODE);
+
+  /* Holding LOCK throughout keeps writes from being denied
+     between the check and the allocation. */
+  lock_acquire (&inode->lock);
+  success = inode->deny_write_cnt == 0;
+  if (success
+      && (is_inline (inode)
+          ? length > INODE_INLINE_SIZE
+          : bytes_to_sectors (length) > inode->data.sector_cnt))
+    success = relocate (inode, bytes_to_sectors (length));
+  lock_release (&inode->lock);
+
+  rwlock_release_write (&inode->rw);
+  journal_end ();
+
+  return success;
+}
+
+/* Extends INODE to LENGTH bytes if it is shorter, then writes
+   zeros to all of its data that has not yet been written, for
+   callers that need the file's sectors initialized on disk up
+   front instead of on demand.  Returns true if successful, false
+   if writes to INODE are denied or it cannot be extended. */
+bool
+inode_zero_fill (struct inode *inode, off_t length) 
+{
+  enum disk_user old_user;
+  bool dirty = false;
+  bool success;
+
+  if (!journal_begin (extend_credits (inode, length)))
+    return false;
+  filesys_rwlock (&inode->rw, true, FS_LOCK_INODE);
+
+  /* As in inode_reserve(). */
+  lock_acquire (&inode->lock);
+  success = inode->deny_write_cnt == 0;
+  old_user = disk_set_user (data_user (inode));
+  if (success && length > inode->data.length)
+    dirty = success = extend (inode, length);
+  if (success && inode->data.valid_length < inode->data.length) 
+    {
+      zero_gap (inode, inode->data.length);
+      inode->data.valid_length = inode->data.length;
+      dirty = true;
+    }
+  if (dirty)
+    cache_log (inode->sector, &inode->data);
+  disk_set_user (old_user);
+  lock_release (&inode->lock);
+
+  rwlock_release_write (&inode->rw);
+  journal_end ();
+
+  return success;
+}
+
+/* Writes INODE's dirty data to disk, in sector order, then
+   commits the journal, so that INODE and its data are both
+   durable when this function returns. */
+void
+inode_sync (struct inode *inode) 
+{
+  cache_flush (inode->sector);
+  journal_commit ();
+}
+
+/* Makes in-place writes to INODE's data go through the journal,
+   like writes to the inode itself.  For inodes whose data is
+   file system metadata, such as directories. */
+void
+inode_journal_data (struct inode *inode) 
+{
+  lock_acquire (&inode->lock);
+  inode->journal_data = true;
+  lock_release (&inode->lock);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +815,33 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->lock);
+}
+
+/* Acquires INODE's directory lock, for writing if WRITE is true
+   or for reading otherwise.  Directory code holds this lock to
+   make lookups and updates of the entries stored in INODE
+   atomic.  It is separate from the lock that inode_read_at() and
+   inode_write_at() take internally. */
+void
+inode_lock_dir (struct inode *inode, bool write) 
+{
+  filesys_rwlock (&inode->dir_rw, write, FS_LOCK_DIR);
+}
+
+/* Releases INODE's directory lock, which the caller acquired
+   with inode_lock_dir() with the same WRITE argument. */
+void
+inode_unlock_dir (struct inode *inode, bool write) 
+{
+  if (write)
+    rwlock_release_write (&inode->dir_rw);
+  else
+    rwlock_release_read (&inode->dir_rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
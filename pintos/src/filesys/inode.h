@@ -9,6 +9,7 @@ struct bitmap;
 
 void inode_init (void);
 bool inode_create (disk_sector_t, off_t);
+size_t inode_create_credits (off_t);
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
@@ -16,8 +17,15 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+size_t inode_write_credits (const struct inode *, off_t size, off_t offset);
+bool inode_reserve (struct inode *, off_t length);
+bool inode_zero_fill (struct inode *, off_t length);
+void inode_sync (struct inode *);
+void inode_journal_data (struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+void inode_lock_dir (struct inode *, bool write);
+void inode_unlock_dir (struct inode *, bool write);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,645 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Metadata sectors -- inodes, directory data and the free map --
+   are not written in place.  journal_log() instead records the
+   sector's new contents in memory as part of the running
+   transaction.  Committing the transaction appends it to the log
+   in one sequential run of writes: a descriptor sector that lists
+   the home sectors, their new contents, and a commit sector.
+   Only after that are the sectors written to their home
+   locations, in a "checkpoint" that happens when the log runs
+   short of space or at shutdown.  Until then the logged contents
+   stay in memory, and journal_read() supplies them in place of
+   the stale copies on disk.
+
+   After a crash, journal_init() writes every transaction in the
+   log that has a commit sector to its home locations, so
+   recovery takes time proportional to the log, not to the disk.
+
+   An operation that updates several sectors brackets its updates
+   with journal_begin() and journal_end().  Transactions only
+   commit when no such operation is in progress, so each
+   operation's updates commit together, and many operations are
+   grouped into each commit.  Every update of metadata after
+   formatting is part of such an operation, except that file data
+   written over a sector that is still in the log must be logged
+   too (see journal_update()).
+
+   Since a transaction cannot commit in the middle of an
+   operation, each operation must fit in what is left of it.  So
+   journal_begin() takes a number of "credits", a bound on the
+   sectors the operation will log, and waits until the running
+   transaction has room for them all, committing it if need be.
+   An operation that needs more than JOURNAL_MAX_CREDITS cannot
+   fit in any transaction, and fails instead.
+
+   Before a transaction commits, all dirty file data in the
+   buffer cache is written back.  A committed inode therefore
+   never claims data that is not yet on disk: after a crash, the
+   sectors within a file's valid length hold what was written to
+   them, not what they held before they were allocated.
+
+   The journal occupies JOURNAL_SECTORS sectors starting at
+   JOURNAL_SECTOR: a superblock followed by the log. */
+
+/* Identifies a journal header sector. */
+#define JOURNAL_MAGIC 0x4c4e524a
+
+/* Kinds of journal header sectors. */
+enum journal_type
+  {
+    JOURNAL_SUPER,              /* Superblock. */
+    JOURNAL_DESCRIPTOR,         /* Start of a transaction. */
+    JOURNAL_COMMIT              /* End of a transaction. */
+  };
+
+/* Number of log sectors. */
+#define LOG_SECTORS (JOURNAL_SECTORS - 1)
+
+/* A transaction this large is committed as soon as no operation
+   is in progress, and new operations wait for that to happen. */
+#define TXN_SOFT_CNT 48
+
+/* Maximum number of sectors in a transaction, as many as a
+   descriptor can list.  Operations reserve at most
+   JOURNAL_MAX_CREDITS of them; the rest is left for file data
+   logged by journal_update(), which reserves nothing. */
+#define TXN_MAX_CNT 124
+
+/* A journal header sector: the superblock, or a descriptor or
+   commit sector in the log.
+   Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t type;                      /* A JOURNAL_* type. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Number of sectors logged. */
+    disk_sector_t sectors[TXN_MAX_CNT]; /* Home sectors of logged data. */
+  };
+
+/* A sector whose latest contents are in the journal but not yet
+   in their home location. */
+struct journal_block
+  {
+    struct hash_elem hash_elem;         /* Element in `blocks'. */
+    struct list_elem list_elem;         /* Element in `running'. */
+    disk_sector_t sector;               /* Home sector. */
+    bool running;                       /* Changed by running transaction? */
+    struct disk_request request;        /* Write to log or home sector. */
+    uint8_t data[DISK_SECTOR_SIZE];     /* Latest contents. */
+  };
+
+/* JOURNAL_LOCK protects everything below.  It is held across the
+   disk writes of commits and checkpoints, but never while
+   acquiring any other file system lock. */
+static struct lock journal_lock;
+static struct condition txn_changed;    /* Signaled when an operation
+                                           ends or a commit finishes. */
+static int handle_cnt;                  /* Operations in progress. */
+static size_t reserved_cnt;             /* Their unused credits. */
+static bool committing;                 /* Writing back data to commit? */
+
+static struct hash blocks;              /* Logged, not checkpointed. */
+static struct list running;             /* Blocks in running transaction. */
+static size_t running_cnt;              /* Length of RUNNING. */
+static uint32_t seq;                    /* Running transaction's number. */
+static size_t log_used;                 /* Log sectors used. */
+static struct journal_header *header;   /* Header sector buffer. */
+
+/* Statistics. */
+static long long commit_cnt;            /* Transactions committed. */
+static long long logged_cnt;            /* Sectors written to the log. */
+static long long checkpoint_cnt;        /* Checkpoints. */
+
+static hash_hash_func block_hash;
+static hash_less_func block_less;
+static void recover (void);
+static void write_super (void);
+static void ordered_commit (void);
+static void commit (void);
+static void checkpoint (void);
+
+/* Initializes the journal.  If FORMAT is true, creates an empty
+   journal; otherwise, recovers any transactions that were
+   committed but not checkpointed before the system stopped. */
+void
+journal_init (bool format)
+{
+  enum disk_user old_user;
+
+  if (disk_size (filesys_disk) < JOURNAL_SECTOR + JOURNAL_SECTORS)
+    PANIC ("file system disk too small for journal");
+
+  lock_init (&journal_lock);
+  cond_init (&txn_changed);
+  hash_init (&blocks, block_hash, block_less, NULL);
+  list_init (&running);
+  header = malloc (sizeof *header);
+  if (header == NULL)
+    PANIC ("journal initialization failed");
+  ASSERT (sizeof *header == DISK_SECTOR_SIZE);
+
+  old_user = disk_set_user (DISK_USER_JOURNAL);
+  if (format)
+    {
+      seq = 1;
+      write_super ();
+    }
+  else
+    recover ();
+  disk_set_user (old_user);
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void)
+{
+  printf ("Journal: %lld commits, %lld sectors logged, %lld checkpoints\n",
+          commit_cnt, logged_cnt, checkpoint_cnt);
+}
+
+/* Returns true if the running transaction has room for CREDITS
+   more sectors besides those already reserved.  The caller must
+   hold journal_lock. */
+static bool
+has_room (size_t credits)
+{
+  return running_cnt + reserved_cnt + credits <= JOURNAL_MAX_CREDITS;
+}
+
+/* Begins an operation whose updates must commit together, and
+   reserves room in the running transaction for CREDITS sectors,
+   at least as many distinct metadata sectors as the operation
+   will log.  Returns true if successful; the operation must then
+   be ended with journal_end().  Returns false, beginning
+   nothing, if CREDITS is more than JOURNAL_MAX_CREDITS.
+
+   Must not be called while holding any other file system lock,
+   because it may wait for the running transaction to commit,
+   unless the current thread is already inside an operation: then
+   the new operation becomes part of the one in progress, and
+   fails instead of waiting if the room it needs is not free. */
+bool
+journal_begin (size_t credits)
+{
+  struct thread *t = thread_current ();
+  bool success = true;
+
+  if (credits > JOURNAL_MAX_CREDITS)
+    return false;
+
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  if (t->journal_depth > 0)
+    success = has_room (credits);
+  else 
+    {
+      while (committing || running_cnt >= TXN_SOFT_CNT || !has_room (credits))
+        if (handle_cnt == 0 && !committing)
+          ordered_commit ();
+        else
+          cond_wait (&txn_changed, &journal_lock);
+      handle_cnt++;
+    }
+  if (success) 
+    {
+      t->journal_depth++;
+      t->journal_credits += credits;
+      reserved_cnt += credits;
+    }
+  lock_release (&journal_lock);
+  return success;
+}
+
+/* Ends an operation begun with journal_begin(), returning its
+   unused credits. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  ASSERT (handle_cnt > 0);
+  reserved_cnt -= t->journal_credits;
+  t->journal_credits = 0;
+  if (--handle_cnt == 0 && running_cnt >= TXN_SOFT_CNT)
+    ordered_commit ();
+  cond_broadcast (&txn_changed, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Returns the number of credits that the operation the current
+   thread is in has not used yet, so that a step whose cost is
+   only known once it holds the locks it needs can check that it
+   fits. */
+size_t
+journal_credits (void)
+{
+  return thread_current ()->journal_credits;
+}
+
+/* Commits the running transaction to the log, waiting for
+   operations in progress to end first.  Must not be called
+   between journal_begin() and journal_end(). */
+void
+journal_commit (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  while (handle_cnt > 0 || committing)
+    cond_wait (&txn_changed, &journal_lock);
+  ordered_commit ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction and writes everything in the
+   log to its home location, leaving the log empty.  Must not be
+   called between journal_begin() and journal_end(). */
+void
+journal_checkpoint (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  while (handle_cnt > 0 || committing)
+    cond_wait (&txn_changed, &journal_lock);
+  ordered_commit ();
+  if (log_used > 0)
+    checkpoint ();
+  lock_release (&journal_lock);
+}
+
+/* Returns the block for SECTOR, or a null pointer if SECTOR has
+   not been logged since the last checkpoint. */
+static struct journal_block *
+find_block (disk_sector_t sector)
+{
+  struct journal_block key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&blocks, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct journal_block, hash_elem) : NULL;
+}
+
+/* Adds DATA, the new contents of SECTOR, to the running
+   transaction, and returns true.  The caller must hold
+   journal_lock.
+
+   If CREDITED, DATA is an update made by the current thread's
+   operation, and a sector new to the transaction uses one of its
+   credits.  Otherwise, it is file data logged by
+   journal_update(), or metadata logged while formatting, and
+   takes room that no operation has reserved.  If there is none
+   and nothing is in progress, the transaction is committed on
+   the spot, without first writing back file data, since the
+   caller may be doing just that; if operations are in progress,
+   returns false without logging DATA. */
+static bool
+log_block (disk_sector_t sector, const void *data, bool credited)
+{
+  struct thread *t = thread_current ();
+  struct journal_block *b = find_block (sector);
+
+  if (b == NULL || !b->running)
+    {
+      if (credited && t->journal_credits > 0) 
+        {
+          t->journal_credits--;
+          reserved_cnt--;
+        }
+      else 
+        {
+          if (running_cnt + reserved_cnt >= TXN_MAX_CNT && handle_cnt == 0) 
+            {
+              /* Committing may checkpoint, which frees B. */
+              commit ();
+              b = find_block (sector);
+            }
+          if (running_cnt + reserved_cnt >= TXN_MAX_CNT) 
+            {
+              if (credited)
+                PANIC ("journal operation logged more than its credits");
+              return false;
+            }
+        }
+      if (b == NULL)
+        {
+          b = malloc (sizeof *b);
+          if (b == NULL)
+            PANIC ("out of memory for journal");
+          b->sector = sector;
+          hash_insert (&blocks, &b->hash_elem);
+        }
+      b->running = true;
+      list_push_back (&running, &b->list_elem);
+      running_cnt++;
+    }
+  memcpy (b->data, data, DISK_SECTOR_SIZE);
+  return true;
+}
+
+/* Records DATA, which must be DISK_SECTOR_SIZE bytes, as the
+   new contents of metadata sector SECTOR.  The sector reaches
+   the log when the running transaction commits. */
+void
+journal_log (disk_sector_t sector, const void *data)
+{
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  log_block (sector, data, true);
+  lock_release (&journal_lock);
+}
+
+/* If SECTOR has been logged since the last checkpoint, logs DATA
+   as its new contents and returns true.  Otherwise, returns
+   false, and the caller should write SECTOR in place.
+
+   Writing in place a sector that is in the log would be undone
+   when the log is checkpointed or replayed, which can happen
+   when a metadata sector is freed and reused for file data.
+
+   If the running transaction is full and operations in progress
+   keep it from committing, DATA only replaces the logged
+   contents in memory, so that journal_read() and the next
+   checkpoint use it, and false is returned so that it is written
+   in place too.  Only replaying the log after a crash can then
+   bring back the older contents, and only of a file data
+   sector. */
+bool
+journal_update (disk_sector_t sector, const void *data)
+{
+  struct journal_block *b;
+  bool logged;
+
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  b = find_block (sector);
+  logged = b != NULL && log_block (sector, data, false);
+  if (b != NULL && !logged)
+    memcpy (b->data, data, DISK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+  return logged;
+}
+
+/* If SECTOR has been logged since the last checkpoint, copies
+   its latest contents into DATA and returns true.  Otherwise,
+   returns false, and the copy on disk is current. */
+bool
+journal_read (disk_sector_t sector, void *data)
+{
+  struct journal_block *b;
+
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  b = find_block (sector);
+  if (b != NULL)
+    memcpy (data, b->data, DISK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+  return b != NULL;
+}
+
+/* Returns the disk sector of log sector POS. */
+static disk_sector_t
+log_sector (size_t pos)
+{
+  ASSERT (pos < LOG_SECTORS);
+  return JOURNAL_SECTOR + 1 + pos;
+}
+
+/* Writes the superblock, recording that the log is empty and
+   that the next transaction is number SEQ. */
+static void
+write_super (void)
+{
+  memset (header, 0, sizeof *header);
+  header->magic = JOURNAL_MAGIC;
+  header->type = JOURNAL_SUPER;
+  header->seq = seq;
+  disk_write (filesys_disk, JOURNAL_SECTOR, header);
+}
+
+/* Returns true if H is a valid header of the given TYPE for
+   transaction SEQ_. */
+static bool
+header_valid (const struct journal_header *h, enum journal_type type,
+              uint32_t seq_)
+{
+  return (h->magic == JOURNAL_MAGIC && h->type == type && h->seq == seq_
+          && h->cnt <= TXN_MAX_CNT);
+}
+
+/* Replays the committed transactions in the log, in order, and
+   empties it. */
+static void
+recover (void)
+{
+  struct journal_header *commit_header;
+  size_t pos = 0;
+  int replay_cnt = 0;
+
+  disk_read (filesys_disk, JOURNAL_SECTOR, header);
+  if (header->magic != JOURNAL_MAGIC || header->type != JOURNAL_SUPER)
+    PANIC ("file system has no journal (reformat with -f)");
+  seq = header->seq;
+
+  commit_header = malloc (sizeof *commit_header);
+  if (commit_header == NULL)
+    PANIC ("journal recovery failed");
+
+  /* Transactions follow each other from the start of the log with
+     consecutive sequence numbers.  The first one that is not
+     complete, or left over from before the last checkpoint, ends
+     the log. */
+  while (pos + 2 <= LOG_SECTORS)
+    {
+      size_t i;
+
+      disk_read (filesys_disk, log_sector (pos), header);
+      if (!header_valid (header, JOURNAL_DESCRIPTOR, seq)
+          || pos + header->cnt + 2 > LOG_SECTORS)
+        break;
+      disk_read (filesys_disk, log_sector (pos + header->cnt + 1),
+                 commit_header);
+      if (!header_valid (commit_header, JOURNAL_COMMIT, seq)
+          || commit_header->cnt != header->cnt)
+        break;
+
+      for (i = 0; i < header->cnt; i++)
+        {
+          disk_read (filesys_disk, log_sector (pos + 1 + i), commit_header);
+          disk_write (filesys_disk, header->sectors[i], commit_header);
+        }
+      pos += header->cnt + 2;
+      seq++;
+      replay_cnt++;
+    }
+  free (commit_header);
+
+  if (replay_cnt > 0)
+    printf ("journal: replayed %d transactions\n", replay_cnt);
+  write_super ();
+}
+
+/* Writes back all dirty file data, then commits the running
+   transaction.  The caller must hold journal_lock, and no
+   operation may be in progress.  journal_lock is released while
+   the data is written back, because that logs any of it that
+   goes to sectors still in the log (see journal_update()); new
+   operations wait for the commit meanwhile. */
+static void
+ordered_commit (void)
+{
+  ASSERT (handle_cnt == 0 && !committing);
+
+  if (running_cnt == 0)
+    return;
+
+  committing = true;
+  lock_release (&journal_lock);
+  cache_flush_all ();
+  filesys_lock (&journal_lock, FS_LOCK_JOURNAL);
+  commit ();
+  committing = false;
+  cond_broadcast (&txn_changed, &journal_lock);
+}
+
+/* Writes the running transaction to the log, then checkpoints if
+   the log has no room for another full transaction.  The caller
+   must hold journal_lock, and no operation may be in progress
+   unless the caller is logging outside of one. */
+static void
+commit (void)
+{
+  struct disk_request header_request;
+  enum disk_user old_user;
+  struct list_elem *e;
+  size_t i;
+
+  if (running_cnt == 0)
+    return;
+  ASSERT (log_used + running_cnt + 2 <= LOG_SECTORS);
+  old_user = disk_set_user (DISK_USER_JOURNAL);
+
+  /* Descriptor. */
+  memset (header, 0, sizeof *header);
+  header->magic = JOURNAL_MAGIC;
+  header->type = JOURNAL_DESCRIPTOR;
+  header->seq = seq;
+  header->cnt = running_cnt;
+  i = 0;
+  for (e = list_begin (&running); e != list_end (&running); e = list_next (e))
+    header->sectors[i++] = list_entry (e, struct journal_block,
+                                       list_elem)->sector;
+  disk_submit (&header_request, filesys_disk, log_sector (log_used),
+               header, 1, true, NULL, NULL);
+
+  /* Contents.  They occupy consecutive log sectors after the
+     descriptor, so the disk driver writes them all together. */
+  i = 1;
+  for (e = list_begin (&running); e != list_end (&running); e = list_next (e))
+    {
+      struct journal_block *b = list_entry (e, struct journal_block,
+                                            list_elem);
+      disk_submit (&b->request, filesys_disk, log_sector (log_used + i++),
+                   b->data, 1, true, NULL, NULL);
+    }
+  disk_wait (&header_request);
+  for (e = list_begin (&running); e != list_end (&running); e = list_next (e))
+    disk_wait (&list_entry (e, struct journal_block, list_elem)->request);
+
+  /* Commit sector.  Once it is on disk, the transaction will be
+     replayed after a crash. */
+  header->type = JOURNAL_COMMIT;
+  disk_write (filesys_disk, log_sector (log_used + i), header);
+
+  log_used += running_cnt + 2;
+  logged_cnt += running_cnt;
+  commit_cnt++;
+  seq++;
+  while (!list_empty (&running))
+    {
+      struct journal_block *b = list_entry (list_pop_front (&running),
+                                            struct journal_block, list_elem);
+      b->running = false;
+    }
+  running_cnt = 0;
+
+  if (LOG_SECTORS - log_used < TXN_MAX_CNT + 2)
+    checkpoint ();
+  disk_set_user (old_user);
+}
+
+/* Frees the journal block that contains E. */
+static void
+free_block (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct journal_block, hash_elem));
+}
+
+/* Writes every logged sector to its home location and empties
+   the log.  The caller must hold journal_lock, and the running
+   transaction must be empty. */
+static void
+checkpoint (void)
+{
+  enum disk_user old_user;
+  struct hash_iterator i;
+
+  ASSERT (running_cnt == 0);
+  old_user = disk_set_user (DISK_USER_JOURNAL);
+
+  /* Submit every write before waiting for any, so that the disk
+     driver can order them by sector. */
+  hash_first (&i, &blocks);
+  while (hash_next (&i))
+    {
+      struct journal_block *b = hash_entry (hash_cur (&i),
+                                            struct journal_block, hash_elem);
+      disk_submit (&b->request, filesys_disk, b->sector, b->data, 1, true,
+                   NULL, NULL);
+    }
+  hash_first (&i, &blocks);
+  while (hash_next (&i))
+    disk_wait (&hash_entry (hash_cur (&i), struct journal_block,
+                            hash_elem)->request);
+  hash_clear (&blocks, free_block);
+
+  /* Only now may the log be reused. */
+  write_super ();
+  log_used = 0;
+  checkpoint_cnt++;
+  disk_set_user (old_user);
+}
+
+/* Returns a hash value for the journal block that contains E. */
+static unsigned
+block_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct journal_block, hash_elem)->sector);
+}
+
+/* Returns true if journal block A precedes journal block B. */
+static bool
+block_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct journal_block *a = hash_entry (a_, struct journal_block,
+                                              hash_elem);
+  const struct journal_block *b = hash_entry (b_, struct journal_block,
+                                              hash_elem);
+  return a->sector < b->sector;
+}
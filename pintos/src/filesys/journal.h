@@ -0,0 +1,28 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+/* Number of sectors reserved for the journal, starting at
+   JOURNAL_SECTOR. */
+#define JOURNAL_SECTORS 256
+
+/* Most credits one operation may reserve (see journal_begin()). */
+#define JOURNAL_MAX_CREDITS 96
+
+void journal_init (bool format);
+void journal_print_stats (void);
+
+bool journal_begin (size_t credits);
+void journal_end (void);
+size_t journal_credits (void);
+void journal_commit (void);
+void journal_checkpoint (void);
+
+void journal_log (disk_sector_t, const void *);
+bool journal_update (disk_sector_t, const void *);
+bool journal_read (disk_sector_t, void *);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,17 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+/* Values for d_type. */
+#define DT_REG 1                /* Regular file. */
+#define DT_DIR 2                /* Directory. */
+
+/* One directory entry as returned by getdents(). */
+struct dirent
+  {
+    int d_ino;                  /* Inode number. */
+    int d_type;                 /* DT_REG or DT_DIR. */
+    int d_size;                 /* File size in bytes. */
+    char d_name[15];            /* Null-terminated file name. */
+  };
+
+#endif /* lib/dirent.h */
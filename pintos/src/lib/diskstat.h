@@ -0,0 +1,51 @@
+#ifndef __LIB_DISKSTAT_H
+#define __LIB_DISKSTAT_H
+
+/* Users of a disk, for attributing disk requests. */
+enum disk_user
+  {
+    DISK_USER_OTHER,            /* Not attributed. */
+    DISK_USER_SWAP,             /* Swap space. */
+    DISK_USER_INODE,            /* File system inodes. */
+    DISK_USER_DIR,              /* Directory data. */
+    DISK_USER_FREE_MAP,         /* Free map data. */
+    DISK_USER_DATA,             /* Regular file data. */
+    DISK_USER_JOURNAL,          /* Journal log and checkpoints. */
+    DISK_USER_CNT
+  };
+
+/* Number of buckets in a latency histogram.  Bucket 0 counts
+   latencies under 32 us, bucket I from 1 to DISK_HIST_CNT - 2
+   counts latencies from 2**(I+4) up to 2**(I+5) us, and the last
+   bucket counts all longer latencies. */
+#define DISK_HIST_CNT 16
+
+/* Per-user totals. */
+struct disk_user_stat
+  {
+    long long request_cnt;      /* Requests completed. */
+    long long sector_cnt;       /* Sectors transferred. */
+    long long usecs;            /* Time from submission to completion. */
+  };
+
+/* Statistics for one disk, as returned by diskstat(). */
+struct disk_stat
+  {
+    char name[8];               /* Name, e.g. "hd0:1" or "vda". */
+    unsigned capacity;          /* Capacity in sectors. */
+    long long read_cnt;         /* Sectors read. */
+    long long write_cnt;        /* Sectors written. */
+    long long request_cnt;      /* Requests completed. */
+    long long sequential_cnt;   /* Those that began where the last one
+                                   serviced on the disk ended. */
+    long long depth_sum;        /* Sum of queue depths seen on submission,
+                                   counting the new request. */
+    int max_depth;              /* Greatest queue depth. */
+    long long wait_usecs;       /* Total time from submission to service. */
+    long long service_usecs;    /* Total time being serviced. */
+    long long wait_hist[DISK_HIST_CNT];         /* Requests by wait. */
+    long long service_hist[DISK_HIST_CNT];      /* Requests by service. */
+    struct disk_user_stat users[DISK_USER_CNT]; /* Indexed by disk_user. */
+  };
+
+#endif /* lib/diskstat.h */
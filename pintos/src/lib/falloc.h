@@ -0,0 +1,8 @@
+#ifndef __LIB_FALLOC_H
+#define __LIB_FALLOC_H
+
+/* Flags for fallocate(). */
+#define FALLOC_ZERO 0x1         /* Also extend the file to the reserved
+                                   length, writing zeros to disk. */
+
+#endif /* lib/falloc.h */
@@ -28,7 +28,21 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* File system extensions. */
+    SYS_FSYNC,                  /* Writes a file to disk. */
+    SYS_SYNC,                   /* Writes all files to disk. */
+    SYS_PREAD,                  /* Reads from a file at a given offset. */
+    SYS_PWRITE,                 /* Writes to a file at a given offset. */
+    SYS_READV,                  /* Reads from a file into several buffers. */
+    SYS_WRITEV,                 /* Writes several buffers to a file. */
+    SYS_COPY_FILE_RANGE,        /* Copies data from one file to another. */
+    SYS_PIPE,                   /* Creates a pipe. */
+    SYS_DUP2,                   /* Duplicates a file descriptor. */
+    SYS_GETDENTS,               /* Reads several directory entries. */
+    SYS_FALLOCATE,              /* Reserves disk space for a file. */
+    SYS_DISKSTAT                /* Reports disk statistics. */
   };
 
 #endif /* lib/syscall-nr.h */
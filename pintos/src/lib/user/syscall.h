@@ -3,6 +3,10 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <dirent.h>
+#include <diskstat.h>
+#include <falloc.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +49,18 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* File system extensions. */
+int fsync (int fd);
+void sync (void);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int copy_file_range (int in_fd, int out_fd, unsigned length);
+int pipe (int fds[2]);
+int dup2 (int old_fd, int new_fd);
+int getdents (int fd, struct dirent *ents, unsigned cnt);
+int fallocate (int fd, unsigned length, int flags);
+int diskstat (int disk_no, struct disk_stat *);
+
 #endif /* lib/user/syscall.h */
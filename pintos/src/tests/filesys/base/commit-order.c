@@ -0,0 +1,69 @@
+/* Grows a file, leaving its new data in the buffer cache, then
+   creates files until the journal commits on its own, and checks
+   with diskstat() that the file's data reached the disk no later
+   than the commit that records its new length. */
+
+#include <diskstat.h>
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[2048];
+
+/* Stores into *DATA_CNT the number of sectors of file data, and
+   into *JOURNAL_CNT the number of journal requests, counted on
+   all disks. */
+static void
+count (long long *data_cnt, long long *journal_cnt) 
+{
+  struct disk_stat st;
+  int disk_no;
+
+  *data_cnt = *journal_cnt = 0;
+  for (disk_no = 0; diskstat (disk_no, &st) == 0; disk_no++) 
+    {
+      *data_cnt += st.users[DISK_USER_DATA].sector_cnt;
+      *journal_cnt += st.users[DISK_USER_JOURNAL].request_cnt;
+    }
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "ordered";
+  long long data_before, journal_before;
+  long long data_after, journal_after;
+  int fd, i;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+
+  count (&data_before, &journal_before);
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+         "write \"%s\"", file_name);
+
+  msg ("create files until the journal commits");
+  for (i = 0; i < 200; i++) 
+    {
+      char name[16];
+
+      count (&data_after, &journal_after);
+      if (journal_after > journal_before)
+        break;
+      snprintf (name, sizeof name, "file%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+    }
+  if (journal_after == journal_before)
+    fail ("journal did not commit after %d creates", i);
+  if (data_after - data_before < (long long) (sizeof buf / 512))
+    fail ("journal committed with %lld of %zu sectors of file data written",
+          data_after - data_before, sizeof buf / 512);
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
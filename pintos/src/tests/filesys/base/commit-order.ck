@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(commit-order) begin
+(commit-order) create "ordered"
+(commit-order) open "ordered"
+(commit-order) write "ordered"
+(commit-order) create files until the journal commits
+(commit-order) close "ordered"
+(commit-order) open "ordered" for verification
+(commit-order) verified contents of "ordered"
+(commit-order) close "ordered"
+(commit-order) end
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Copies a file with copy_file_range() in two pieces and
+   verifies the copy.  Also checks that a bad file descriptor and
+   a copy of a file onto an overlapping part of itself are
+   rejected. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[9000];
+
+void
+test_main (void) 
+{
+  int in_fd, out_fd;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create ("source", sizeof buf), "create \"source\"");
+  CHECK ((in_fd = open ("source")) > 1, "open \"source\"");
+  CHECK (write (in_fd, buf, sizeof buf) == (int) sizeof buf,
+         "write \"source\"");
+  CHECK (create ("copy", 0), "create \"copy\"");
+  CHECK ((out_fd = open ("copy")) > 1, "open \"copy\"");
+
+  seek (in_fd, 0);
+  CHECK (copy_file_range (in_fd, out_fd, 5000) == 5000,
+         "copy first 5000 bytes");
+  CHECK (copy_file_range (in_fd, out_fd, 5000) == 4000,
+         "copy remaining 4000 bytes");
+  CHECK (copy_file_range (in_fd, out_fd, 5000) == 0, "copy at end of file");
+  CHECK (copy_file_range (in_fd, out_fd + 100, 10) == -1, "copy to bad fd");
+
+  seek (in_fd, 100);
+  CHECK (copy_file_range (in_fd, in_fd, 10) == -1, "copy onto itself");
+
+  msg ("close \"source\"");
+  close (in_fd);
+  msg ("close \"copy\"");
+  close (out_fd);
+  check_file ("copy", buf, sizeof buf);
+}
@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(copy-file-range) begin
+(copy-file-range) create "source"
+(copy-file-range) open "source"
+(copy-file-range) write "source"
+(copy-file-range) create "copy"
+(copy-file-range) open "copy"
+(copy-file-range) copy first 5000 bytes
+(copy-file-range) copy remaining 4000 bytes
+(copy-file-range) copy at end of file
+(copy-file-range) copy to bad fd
+(copy-file-range) copy onto itself
+(copy-file-range) close "source"
+(copy-file-range) close "copy"
+(copy-file-range) open "copy" for verification
+(copy-file-range) verified contents of "copy"
+(copy-file-range) close "copy"
+(copy-file-range) end
+EOF
+pass;
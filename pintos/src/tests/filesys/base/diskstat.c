@@ -0,0 +1,70 @@
+/* Writes a file and flushes it with fsync(), then checks that
+   the statistics diskstat() reports for each disk are consistent
+   and attribute the file's sectors to file data.  Also checks
+   that diskstat() rejects a bad disk number. */
+
+#include <diskstat.h>
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[8192];
+
+/* Returns the sum of the CNT elements of HIST. */
+static long long
+sum (const long long *hist, int cnt) 
+{
+  long long total = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    total += hist[i];
+  return total;
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "counted";
+  struct disk_stat st;
+  long long data_cnt = 0;
+  int disk_no, fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) == (int) sizeof buf,
+         "write \"%s\"", file_name);
+  CHECK (fsync (fd) == 0, "fsync \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  msg ("check statistics");
+  for (disk_no = 0; diskstat (disk_no, &st) == 0; disk_no++) 
+    {
+      long long user_cnt = 0;
+      int i;
+
+      for (i = 0; i < DISK_USER_CNT; i++)
+        user_cnt += st.users[i].request_cnt;
+      if (sum (st.wait_hist, DISK_HIST_CNT) != st.request_cnt
+          || sum (st.service_hist, DISK_HIST_CNT) != st.request_cnt)
+        fail ("%s: histograms count %lld and %lld requests, not %lld",
+              st.name, sum (st.wait_hist, DISK_HIST_CNT),
+              sum (st.service_hist, DISK_HIST_CNT), st.request_cnt);
+      if (user_cnt != st.request_cnt)
+        fail ("%s: users account for %lld requests, not %lld",
+              st.name, user_cnt, st.request_cnt);
+      if (st.sequential_cnt > st.request_cnt)
+        fail ("%s: more sequential requests than requests", st.name);
+      if (st.request_cnt > 0 && st.max_depth < 1)
+        fail ("%s: maximum queue depth %d", st.name, st.max_depth);
+      data_cnt += st.users[DISK_USER_DATA].sector_cnt;
+    }
+  if (disk_no == 0)
+    fail ("diskstat found no disks");
+  if (data_cnt < (long long) (sizeof buf / 512))
+    fail ("only %lld sectors of file data counted", data_cnt);
+  CHECK (diskstat (-1, &st) == -1, "diskstat bad disk");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(diskstat) begin
+(diskstat) create "counted"
+(diskstat) open "counted"
+(diskstat) write "counted"
+(diskstat) fsync "counted"
+(diskstat) close "counted"
+(diskstat) check statistics
+(diskstat) diskstat bad disk
+(diskstat) end
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Reserves 8 MB for a file on a 256 MB disk, then tries to
+   reserve 200 MB.  That much changes more of the free map than
+   one journal transaction can hold, so fallocate() must fail and
+   leave the file as it was, instead of panicking the kernel. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SMALL (8 * 1024 * 1024)
+#define HUGE (200 * 1024 * 1024)
+
+void
+test_main (void) 
+{
+  const char *file_name = "reserved";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fallocate (fd, SMALL, 0) == 0, "fallocate 8 MB");
+  CHECK (fallocate (fd, HUGE, 0) == -1, "fallocate 200 MB fails");
+  CHECK (fallocate (fd, HUGE, FALLOC_ZERO) == -1,
+         "fallocate 200 MB with FALLOC_ZERO fails");
+  CHECK (filesize (fd) == 0, "size is still 0");
+  CHECK (write (fd, "x", 1) == 1, "write 1 byte");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate-huge) begin
+(fallocate-huge) create "reserved"
+(fallocate-huge) open "reserved"
+(fallocate-huge) fallocate 8 MB
+(fallocate-huge) fallocate 200 MB fails
+(fallocate-huge) fallocate 200 MB with FALLOC_ZERO fails
+(fallocate-huge) size is still 0
+(fallocate-huge) write 1 byte
+(fallocate-huge) close "reserved"
+(fallocate-huge) end
+EOF
+pass;
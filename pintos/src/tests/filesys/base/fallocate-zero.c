@@ -0,0 +1,36 @@
+/* Writes the start of a file, extends it with
+   fallocate(FALLOC_ZERO), checks its new size, and verifies that
+   the rest of it reads back as zeros.  Also checks that
+   fallocate() rejects unknown flags. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[12345];
+
+void
+test_main (void) 
+{
+  const char *file_name = "zeroed";
+  const size_t written = 1500;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, written);
+  CHECK (write (fd, buf, written) == (int) written,
+         "write %zu bytes to \"%s\"", written, file_name);
+  CHECK (fallocate (fd, sizeof buf, FALLOC_ZERO) == 0,
+         "fallocate %zu bytes, zeroed", sizeof buf);
+  CHECK (filesize (fd) == (int) sizeof buf, "size is %zu", sizeof buf);
+  CHECK (fallocate (fd, sizeof buf, ~FALLOC_ZERO) == -1,
+         "fallocate with bad flags");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  memset (buf + written, 0, sizeof buf - written);
+  check_file (file_name, buf, sizeof buf);
+}
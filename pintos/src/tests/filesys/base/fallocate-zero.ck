@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate-zero) begin
+(fallocate-zero) create "zeroed"
+(fallocate-zero) open "zeroed"
+(fallocate-zero) write 1500 bytes to "zeroed"
+(fallocate-zero) fallocate 12345 bytes, zeroed
+(fallocate-zero) size is 12345
+(fallocate-zero) fallocate with bad flags
+(fallocate-zero) close "zeroed"
+(fallocate-zero) open "zeroed" for verification
+(fallocate-zero) verified contents of "zeroed"
+(fallocate-zero) close "zeroed"
+(fallocate-zero) end
+EOF
+pass;
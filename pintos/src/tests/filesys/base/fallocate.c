@@ -0,0 +1,37 @@
+/* Reserves space for a file with fallocate(), checks that its
+   size does not change, then fills the reservation with
+   sequential writes and verifies the result. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[20000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "reserved";
+  size_t ofs;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (fallocate (fd, sizeof buf, 0) == 0, "fallocate %zu bytes", sizeof buf);
+  CHECK (filesize (fd) == 0, "size is still 0");
+
+  random_bytes (buf, sizeof buf);
+  msg ("write \"%s\"", file_name);
+  for (ofs = 0; ofs < sizeof buf; ofs += 512) 
+    {
+      size_t size = sizeof buf - ofs < 512 ? sizeof buf - ofs : 512;
+      if (write (fd, buf + ofs, size) != (int) size)
+        fail ("write %zu bytes at offset %zu failed", size, ofs);
+    }
+  CHECK (fallocate (fd, 100, 0) == 0, "fallocate less than size");
+  CHECK (fallocate (fd + 100, 100, 0) == -1, "fallocate bad fd");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
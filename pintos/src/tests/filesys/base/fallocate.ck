@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate) begin
+(fallocate) create "reserved"
+(fallocate) open "reserved"
+(fallocate) fallocate 20000 bytes
+(fallocate) size is still 0
+(fallocate) write "reserved"
+(fallocate) fallocate less than size
+(fallocate) fallocate bad fd
+(fallocate) close "reserved"
+(fallocate) open "reserved" for verification
+(fallocate) verified contents of "reserved"
+(fallocate) close "reserved"
+(fallocate) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Writes a file in several pieces, flushes it with fsync() and
+   sync(), and verifies that its contents are intact afterward.
+   Also checks that fsync() rejects a bad file descriptor. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[7654];
+
+void
+test_main (void) 
+{
+  const char *file_name = "flushed";
+  size_t ofs;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  msg ("write \"%s\"", file_name);
+  for (ofs = 0; ofs < sizeof buf; ofs += 1000) 
+    {
+      size_t size = sizeof buf - ofs < 1000 ? sizeof buf - ofs : 1000;
+      if (write (fd, buf + ofs, size) != (int) size)
+        fail ("write %zu bytes at offset %zu failed", size, ofs);
+    }
+  CHECK (fsync (fd) == 0, "fsync \"%s\"", file_name);
+  CHECK (fsync (fd + 100) == -1, "fsync bad fd");
+  msg ("sync");
+  sync ();
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
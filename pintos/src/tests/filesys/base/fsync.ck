@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync) begin
+(fsync) create "flushed"
+(fsync) open "flushed"
+(fsync) write "flushed"
+(fsync) fsync "flushed"
+(fsync) fsync bad fd
+(fsync) sync
+(fsync) close "flushed"
+(fsync) open "flushed" for verification
+(fsync) verified contents of "flushed"
+(fsync) close "flushed"
+(fsync) end
+EOF
+pass;
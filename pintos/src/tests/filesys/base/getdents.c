@@ -0,0 +1,72 @@
+/* Creates a number of files of different sizes and lists the
+   root directory with getdents(), a few entries per call,
+   checking that every file shows up exactly once with the right
+   size.  Also checks that getdents() rejects a plain file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 30
+
+static char buf[FILE_CNT * 10];
+
+void
+test_main (void) 
+{
+  bool seen[FILE_CNT];
+  struct dirent ents[7];
+  char name[16];
+  int dir_fd, fd;
+  int total = 0;
+  int cnt;
+  int i;
+
+  msg ("create %d files", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\" failed", name);
+      fd = open (name);
+      if (fd < 2 || write (fd, buf, i * 10) != i * 10)
+        fail ("write \"%s\" failed", name);
+      close (fd);
+      seen[i] = false;
+    }
+
+  CHECK ((dir_fd = open ("/")) > 1, "open \"/\"");
+  CHECK (isdir (dir_fd), "isdir \"/\"");
+  msg ("list \"/\"");
+  while ((cnt = getdents (dir_fd, ents, 7)) > 0) 
+    for (i = 0; i < cnt; i++) 
+      {
+        int idx;
+
+        /* Skip the test program itself. */
+        if (memcmp (ents[i].d_name, "file", 4))
+          continue;
+        idx = atoi (ents[i].d_name + 4);
+        if (idx < 0 || idx >= FILE_CNT)
+          fail ("unexpected entry \"%s\"", ents[i].d_name);
+        if (seen[idx])
+          fail ("\"%s\" listed twice", ents[i].d_name);
+        if (ents[i].d_type != DT_REG || ents[i].d_size != idx * 10)
+          fail ("\"%s\" has wrong type or size", ents[i].d_name);
+        seen[idx] = true;
+        total++;
+      }
+  if (cnt < 0)
+    fail ("getdents failed");
+  if (total != FILE_CNT)
+    fail ("listed %d files instead of %d", total, FILE_CNT);
+  msg ("listed all %d files", total);
+  close (dir_fd);
+
+  CHECK ((fd = open ("file3")) > 1, "open \"file3\"");
+  CHECK (getdents (fd, ents, 7) == -1, "getdents on a file");
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents) begin
+(getdents) create 30 files
+(getdents) open "/"
+(getdents) isdir "/"
+(getdents) list "/"
+(getdents) listed all 30 files
+(getdents) open "file3"
+(getdents) getdents on a file
+(getdents) end
+EOF
+pass;
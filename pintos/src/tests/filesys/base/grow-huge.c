@@ -0,0 +1,33 @@
+/* Extends a file on a 256 MB disk by writing past its end, first
+   to 8 MB, then to 200 MB.  Moving the file into a run of 200 MB
+   changes more of the free map than one journal transaction can
+   hold, so the second write must fail and leave the file as it
+   was, instead of panicking the kernel. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SMALL (8 * 1024 * 1024)
+#define HUGE (200 * 1024 * 1024)
+
+void
+test_main (void) 
+{
+  const char *file_name = "huge";
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  seek (fd, SMALL);
+  CHECK (write (fd, "x", 1) == 1, "write 1 byte at 8 MB");
+  CHECK (filesize (fd) == SMALL + 1, "size is 8 MB + 1");
+
+  seek (fd, HUGE);
+  CHECK (write (fd, "x", 1) == 0, "write 1 byte at 200 MB fails");
+  CHECK (filesize (fd) == SMALL + 1, "size is still 8 MB + 1");
+
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
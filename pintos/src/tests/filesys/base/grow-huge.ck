@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-huge) begin
+(grow-huge) create "huge"
+(grow-huge) open "huge"
+(grow-huge) write 1 byte at 8 MB
+(grow-huge) size is 8 MB + 1
+(grow-huge) write 1 byte at 200 MB fails
+(grow-huge) size is still 8 MB + 1
+(grow-huge) close "huge"
+(grow-huge) end
+EOF
+pass;
@@ -0,0 +1,50 @@
+/* Writes a file out of order with pwrite(), reads it back in
+   pieces with pread(), and checks that neither call moves the
+   file position. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[5000];
+static char readback[5000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "positional";
+  size_t ofs;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+
+  msg ("pwrite \"%s\" back to front", file_name);
+  for (ofs = sizeof buf; ofs > 0; )
+    {
+      size_t size = ofs < 700 ? ofs : 700;
+      ofs -= size;
+      if (pwrite (fd, buf + ofs, size, ofs) != (int) size)
+        fail ("pwrite %zu bytes at offset %zu failed", size, ofs);
+    }
+  CHECK (tell (fd) == 0, "file position unchanged by pwrite");
+
+  msg ("pread \"%s\"", file_name);
+  for (ofs = 0; ofs < sizeof buf; ofs += 900)
+    {
+      size_t size = sizeof buf - ofs < 900 ? sizeof buf - ofs : 900;
+      if (pread (fd, readback + ofs, size, ofs) != (int) size)
+        fail ("pread %zu bytes at offset %zu failed", size, ofs);
+    }
+  if (memcmp (buf, readback, sizeof buf))
+    fail ("pread data differs from pwrite data");
+  CHECK (tell (fd) == 0, "file position unchanged by pread");
+  CHECK (pread (fd, readback, 10, sizeof buf) == 0, "pread at end of file");
+  CHECK (pread (fd + 100, readback, 10, 0) == -1, "pread bad fd");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
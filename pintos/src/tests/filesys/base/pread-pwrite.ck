@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "positional"
+(pread-pwrite) open "positional"
+(pread-pwrite) pwrite "positional" back to front
+(pread-pwrite) file position unchanged by pwrite
+(pread-pwrite) pread "positional"
+(pread-pwrite) file position unchanged by pread
+(pread-pwrite) pread at end of file
+(pread-pwrite) pread bad fd
+(pread-pwrite) close "positional"
+(pread-pwrite) open "positional" for verification
+(pread-pwrite) verified contents of "positional"
+(pread-pwrite) close "positional"
+(pread-pwrite) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Writes a file with writev() from buffers of uneven sizes,
+   reads it back with readv() into a different split, and checks
+   that a count of zero or more than IOV_MAX is rejected. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[3000];
+static char readback[3000];
+
+void
+test_main (void) 
+{
+  const char *file_name = "vectored";
+  struct iovec iov[4];
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 1;
+  iov[1].iov_base = buf + 1;
+  iov[1].iov_len = 1499;
+  iov[2].iov_base = buf + 1500;
+  iov[2].iov_len = 0;
+  iov[3].iov_base = buf + 1500;
+  iov[3].iov_len = 1500;
+  CHECK (writev (fd, iov, 4) == (int) sizeof buf, "writev \"%s\"", file_name);
+
+  seek (fd, 0);
+  iov[0].iov_base = readback;
+  iov[0].iov_len = 2000;
+  iov[1].iov_base = readback + 2000;
+  iov[1].iov_len = 2000;
+  CHECK (readv (fd, iov, 2) == (int) sizeof buf, "readv \"%s\"", file_name);
+  if (memcmp (buf, readback, sizeof buf))
+    fail ("readv data differs from writev data");
+
+  CHECK (readv (fd, iov, 0) == -1, "readv with no buffers");
+  CHECK (writev (fd, iov, IOV_MAX + 1) == -1, "writev with too many buffers");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "vectored"
+(readv-writev) open "vectored"
+(readv-writev) writev "vectored"
+(readv-writev) readv "vectored"
+(readv-writev) readv with no buffers
+(readv-writev) writev with too many buffers
+(readv-writev) close "vectored"
+(readv-writev) open "vectored" for verification
+(readv-writev) verified contents of "vectored"
+(readv-writev) close "vectored"
+(readv-writev) end
+EOF
+pass;
@@ -0,0 +1,20 @@
+/* Child process run by pipe-reader-exit test.
+   Writes to standard output, which is a pipe, until a write
+   comes up short because the pipe's reader has gone away. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+int
+main (void) 
+{
+  static char buf[512];
+  int i;
+
+  memset (buf, 'x', sizeof buf);
+  for (i = 0; i < 64; i++)
+    if (write (STDOUT_FILENO, buf, sizeof buf) != (int) sizeof buf)
+      return 42;
+  return 1;
+}
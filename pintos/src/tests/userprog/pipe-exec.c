@@ -0,0 +1,39 @@
+/* Points standard output at a pipe, runs a child process that
+   inherits it, and reads the child's output back from the pipe
+   once the child exits. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const char expected[] = "(child-simple) run\n";
+  char buf[64];
+  int fds[2];
+  int size = 0;
+  int cnt;
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+
+  /* Nothing may be printed while standard output is the pipe. */
+  if (dup2 (fds[1], STDOUT_FILENO) != STDOUT_FILENO)
+    fail ("dup2 failed");
+  close (fds[1]);
+  pid = exec ("child-simple");
+  close (STDOUT_FILENO);
+  if (pid == PID_ERROR)
+    fail ("exec \"child-simple\" failed");
+  CHECK (wait (pid) == 81, "wait for child");
+
+  while ((cnt = read (fds[0], buf + size, sizeof buf - size)) > 0)
+    size += cnt;
+  if (size != (int) strlen (expected) || memcmp (buf, expected, size))
+    fail ("child output through pipe is wrong");
+  msg ("child output came through pipe");
+  close (fds[0]);
+}
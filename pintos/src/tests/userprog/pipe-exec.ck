@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+child-simple: exit(81)
+(pipe-exec) wait for child
+(pipe-exec) child output came through pipe
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
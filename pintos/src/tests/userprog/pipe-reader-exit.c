@@ -0,0 +1,33 @@
+/* Runs a child process that writes much more than a pipe holds
+   to its standard output, a pipe, while the parent holds the
+   only other read end.  The parent closes its read end without
+   reading anything, which must make the child's writes fail
+   instead of blocking forever.  The child must not have inherited
+   the read end. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  pid_t pid;
+
+  CHECK (pipe (fds) == 0, "pipe");
+
+  /* Nothing may be printed while standard output is the pipe. */
+  if (dup2 (fds[1], STDOUT_FILENO) != STDOUT_FILENO)
+    fail ("dup2 failed");
+  close (fds[1]);
+  pid = exec ("child-pipe-wr");
+  close (STDOUT_FILENO);
+  if (pid == PID_ERROR)
+    fail ("exec \"child-pipe-wr\" failed");
+
+  msg ("close read end");
+  close (fds[0]);
+  CHECK (wait (pid) == 42, "wait for child");
+}
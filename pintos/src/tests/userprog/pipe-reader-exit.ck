@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-reader-exit) begin
+(pipe-reader-exit) pipe
+(pipe-reader-exit) close read end
+child-pipe-wr: exit(42)
+(pipe-reader-exit) wait for child
+(pipe-reader-exit) end
+pipe-reader-exit: exit(0)
+EOF
+pass;
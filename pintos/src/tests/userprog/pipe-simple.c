@@ -0,0 +1,47 @@
+/* Passes data through a pipe in one process, more than the pipe
+   holds at once in total, and checks end of file after the write
+   end is closed and failure after the read end is closed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[1000];
+static char readback[1000];
+
+void
+test_main (void) 
+{
+  int fds[2];
+  int i;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  for (i = 0; i < (int) sizeof buf; i++)
+    buf[i] = i % 251;
+
+  msg ("pass 10000 bytes through the pipe");
+  for (i = 0; i < 10; i++) 
+    {
+      if (write (fds[1], buf, sizeof buf) != (int) sizeof buf)
+        fail ("write %d failed", i);
+      if (read (fds[0], readback, sizeof readback) != (int) sizeof readback)
+        fail ("read %d failed", i);
+      if (memcmp (buf, readback, sizeof buf))
+        fail ("data %d differs", i);
+    }
+
+  CHECK (write (fds[1], buf, 10) == 10, "write 10 bytes");
+  msg ("close write end");
+  close (fds[1]);
+  CHECK (read (fds[0], readback, sizeof readback) == 10, "read 10 bytes");
+  CHECK (read (fds[0], readback, sizeof readback) == 0, "read end of file");
+  CHECK (write (fds[0], buf, 10) == -1, "write to read end");
+
+  CHECK (pipe (fds) == 0, "pipe");
+  msg ("close read end");
+  close (fds[0]);
+  CHECK (write (fds[1], buf, 10) == -1, "write with no reader");
+  CHECK (filesize (fds[1]) == -1, "filesize of pipe");
+  close (fds[1]);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-simple) begin
+(pipe-simple) pipe
+(pipe-simple) pass 10000 bytes through the pipe
+(pipe-simple) write 10 bytes
+(pipe-simple) close write end
+(pipe-simple) read 10 bytes
+(pipe-simple) read end of file
+(pipe-simple) write to read end
+(pipe-simple) pipe
+(pipe-simple) close read end
+(pipe-simple) write with no reader
+(pipe-simple) filesize of pipe
+(pipe-simple) end
+pipe-simple: exit(0)
+EOF
+pass;
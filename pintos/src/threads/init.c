@@ -31,6 +31,7 @@
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "devices/virtio-blk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -117,6 +118,7 @@ main (void)
 #ifdef FILESYS
   /* Initialize file system. */
   disk_init ();
+  virtio_blk_init ();
   filesys_init (format_filesys);
 #endif
 
@@ -254,6 +256,8 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-novga"))
+        vga_disable ();
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -359,6 +363,7 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -novga             Write console output to the serial port only.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -399,8 +404,10 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
+  filesys_print_stats ();
 #endif
   console_print_stats ();
+  serial_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
@@ -101,6 +101,14 @@ struct thread
     struct list_elem elem;              /* List element. */
 
     struct list child;          /* child process. */
+
+    /* Owned by devices/disk.c. */
+    int disk_user;                      /* enum disk_user to charge for
+                                           disk requests. */
+
+    /* Owned by filesys/journal.c. */
+    int journal_depth;                  /* Nesting of journal_begin(). */
+    size_t journal_credits;             /* Unused credits of operation. */
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
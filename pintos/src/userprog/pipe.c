@@ -0,0 +1,170 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A pipe: a one-page ring buffer shared by a read end and a
+   write end, each of which may be held by any number of file
+   descriptors.
+
+   HEAD and TAIL count every byte ever written and read, so the
+   buffer holds HEAD - TAIL bytes starting at TAIL % PGSIZE.
+   Readers wait while the buffer is empty and writers wait while
+   it is full.  Once every write end is closed, a reader that
+   finds the buffer empty sees end of file; once every read end
+   is closed, a writer fails. */
+struct pipe
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition readable;  /* Data arrived or last writer left. */
+    struct condition writable;  /* Space freed or last reader left. */
+    uint8_t *buffer;            /* One page of data. */
+    size_t head;                /* Total bytes written. */
+    size_t tail;                /* Total bytes read. */
+    int readers;                /* Number of open read ends. */
+    int writers;                /* Number of open write ends. */
+  };
+
+/* Creates and returns a new, empty pipe with one read end and one
+   write end open.  Returns a null pointer if memory is not
+   available. */
+struct pipe *
+pipe_create (void) 
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+
+  p->buffer = palloc_get_page (0);
+  if (p->buffer == NULL) 
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->readable);
+  cond_init (&p->writable);
+  p->head = p->tail = 0;
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Opens another read end of P, or another write end if
+   WRITE_END is true. */
+void
+pipe_reopen (struct pipe *p, bool write_end) 
+{
+  lock_acquire (&p->lock);
+  if (write_end)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes a read end of P, or a write end if WRITE_END is true,
+   waking anyone who was waiting on the other end.  Frees P once
+   both ends are fully closed. */
+void
+pipe_close (struct pipe *p, bool write_end) 
+{
+  bool dead;
+
+  lock_acquire (&p->lock);
+  if (write_end) 
+    {
+      ASSERT (p->writers > 0);
+      p->writers--;
+      cond_broadcast (&p->readable, &p->lock);
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      p->readers--;
+      cond_broadcast (&p->writable, &p->lock);
+    }
+  dead = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+
+  if (dead) 
+    {
+      palloc_free_page (p->buffer);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into BUFFER, waiting until at
+   least one byte is available unless every write end is closed.
+   Returns the number of bytes read, which is 0 only at end of
+   file or if SIZE is 0. */
+int
+pipe_read (struct pipe *p, void *buffer_, size_t size) 
+{
+  uint8_t *buffer = buffer_;
+  size_t bytes_read = 0;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  while (p->head == p->tail && p->writers > 0)
+    cond_wait (&p->readable, &p->lock);
+  while (bytes_read < size && p->tail != p->head) 
+    {
+      /* Copy up to the end of the data or of the page. */
+      size_t ofs = p->tail % PGSIZE;
+      size_t chunk_size = p->head - p->tail;
+      if (chunk_size > PGSIZE - ofs)
+        chunk_size = PGSIZE - ofs;
+      if (chunk_size > size - bytes_read)
+        chunk_size = size - bytes_read;
+      memcpy (buffer + bytes_read, p->buffer + ofs, chunk_size);
+      p->tail += chunk_size;
+      bytes_read += chunk_size;
+    }
+  cond_broadcast (&p->writable, &p->lock);
+  lock_release (&p->lock);
+
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into P, waiting for readers to
+   make room as needed.  Returns the number of bytes written,
+   which is less than SIZE only if every read end is closed
+   first, or -1 if that happens before anything is written. */
+int
+pipe_write (struct pipe *p, const void *buffer_, size_t size) 
+{
+  const uint8_t *buffer = buffer_;
+  size_t bytes_written = 0;
+
+  lock_acquire (&p->lock);
+  while (bytes_written < size && p->readers > 0) 
+    {
+      size_t ofs = p->head % PGSIZE;
+      size_t chunk_size;
+
+      if (p->head - p->tail == PGSIZE) 
+        {
+          cond_wait (&p->writable, &p->lock);
+          continue;
+        }
+
+      /* Copy up to the start of the data or the end of the page. */
+      chunk_size = PGSIZE - (p->head - p->tail);
+      if (chunk_size > PGSIZE - ofs)
+        chunk_size = PGSIZE - ofs;
+      if (chunk_size > size - bytes_written)
+        chunk_size = size - bytes_written;
+      memcpy (p->buffer + ofs, buffer + bytes_written, chunk_size);
+      p->head += chunk_size;
+      bytes_written += chunk_size;
+      cond_broadcast (&p->readable, &p->lock);
+    }
+  lock_release (&p->lock);
+
+  return bytes_written == 0 && size > 0 ? -1 : (int) bytes_written;
+}
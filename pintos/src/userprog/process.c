@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -142,6 +143,8 @@ start_process (void *f_name)
 
   palloc_free_page (file_name);
   palloc_free_page (argv);
+  // Pick up the parent's pipes while it still waits for us
+  syscall_inherit_fds (thread_current()->parent);
   sema_up(thread_current()->process_sema);
   thread_yield();
   /* ----------------------------------------------------------------- */
@@ -205,6 +208,9 @@ process_exit (void)
     palloc_free_page(c);
   }
 
+  // Close descriptors left open by a process that was killed
+  process_remove_fdlist (curr);
+
   struct file *file = curr->executable;
   if (file != NULL)
   {
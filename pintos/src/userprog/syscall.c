@@ -1,8 +1,13 @@
 #include "userprog/syscall.h"
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
+#include "userprog/pipe.h"
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <uio.h>
+#include <dirent.h>
+#include <diskstat.h>
+#include <falloc.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/init.h"
@@ -10,16 +15,24 @@
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "devices/disk.h"
+#include "devices/input.h"
 
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
 
 #include "vm/page.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #define EXIT_STATUS_1 -1
+
+/* Most directory entries one getdents() call returns. */
+#define GETDENTS_MAX (PGSIZE / sizeof (struct dirent))
  
 static void syscall_handler (struct intr_frame *);
 //static void syscall_exit (int status);
@@ -33,24 +46,46 @@ static bool syscall_remove (const char *file);
 static bool syscall_seem (const char *file);
 static void syscall_seek (int fd, unsigned position);
 static unsigned syscall_tell (int fd);
+static int syscall_fsync (int fd);
+static int syscall_pread (int fd, void *buffer, unsigned length, unsigned offset);
+static int syscall_pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+static int syscall_readv (int fd, const struct iovec *iov, int iovcnt);
+static int syscall_writev (int fd, const struct iovec *iov, int iovcnt);
+static int syscall_copy_file_range (int in_fd, int out_fd, unsigned length);
+static int syscall_pipe (int *fds);
+static int syscall_dup2 (int oldfd, int newfd);
+static int syscall_getdents (int fd, struct dirent *ents, unsigned cnt);
+static bool syscall_isdir (int fd);
+static int syscall_fallocate (int fd, unsigned length, int flags);
+static int syscall_diskstat (int disk_no, struct disk_stat *stat);
+static int syscall_inumber (int fd);
 
 static int get_user (const uint8_t *uaddr);
 
 static void is_valid_ptr (struct intr_frame *f UNUSED, void *uaddr);
 static void is_valid_buffer (struct intr_frame *f UNUSED, void *uaddr, unsigned length, bool write);
 static void is_valid_page (struct intr_frame *f UNUSED, void *uaddr, bool write);
+static bool is_valid_iovec (struct intr_frame *f UNUSED, const struct iovec *iov, int iovcnt, bool write);
 
 static int file_add_fdlist (struct file* file);
+static int pipe_add_fdlist (struct pipe* pipe, bool write_end);
+static int dir_add_fdlist (struct dir* dir);
 static void file_remove_fdlist (int fd);
 static struct file_descriptor * fd_to_file_descriptor (int fd);
+static bool fd_dup (struct thread *t, const struct file_descriptor *old, int fd);
+static void fd_close (struct file_descriptor *desc);
+static int fd_read (struct file_descriptor *desc, void *buffer, unsigned length);
+static int fd_write (struct file_descriptor *desc, const void *buffer, unsigned length);
 
-struct lock lock_file;
+/* There is no global file system lock: each fd table is private
+   to its thread, and the file system synchronizes internally
+   with per-inode, per-directory, free map and buffer cache
+   locks. */
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init (&lock_file);
 }
 
 static void
@@ -73,7 +108,15 @@ syscall_handler (struct intr_frame *f UNUSED)
   void **arg1 = (void **)(syscall_nr+1);
   void **arg2 = (void **)(syscall_nr+2);
   void **arg3 = (void **)(syscall_nr+3);
-  //void **arg4 = (void **)(syscall_nr+4);
+  void **arg4 = (void **)(syscall_nr+4);
+
+  //pread and pwrite take a fourth argument
+  if (*syscall_nr == SYS_PREAD || *syscall_nr == SYS_PWRITE)
+  {
+    if( ( get_user((uint8_t *)arg4) == -1 )
+        || is_kernel_vaddr ((void *)arg4) )
+      syscall_exit(EXIT_STATUS_1);
+  }
 
   switch (*syscall_nr) {
     case SYS_HALT: //0
@@ -106,13 +149,6 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_READ: //8
 
       is_valid_buffer(f, *(void **)arg2, (unsigned)*arg3, true);
-      
-      if((int)*arg1 == 0)
-      {
-        //printf("syscall exit here1\n");
-        syscall_exit(EXIT_STATUS_1);
-      }
-
       f->eax = (uint32_t) syscall_read((int)*arg1, *(void **)arg2, (unsigned)*arg3);
       break;
     case SYS_WRITE: //9
@@ -132,8 +168,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       syscall_seek ((int)*arg1, (unsigned)*arg2);
       break;
     case SYS_TELL:
-      printf("syscall tell\n");
-      // Not implemented
+      f->eax = (uint32_t) syscall_tell ((int)*arg1);
       break;
     case SYS_CLOSE:
       syscall_close((int)*arg1);
@@ -158,12 +193,62 @@ syscall_handler (struct intr_frame *f UNUSED)
       // Not implemented yet
       break;
     case SYS_ISDIR:
-      // Not implemented yet
+      f->eax = (uint32_t) syscall_isdir ((int)*arg1);
       break;
     case SYS_INUMBER:
-      // Not implemented yet
+      f->eax = (uint32_t) syscall_inumber ((int)*arg1);
       break;
 /* ---------------------------------------------------------------------*/
+    case SYS_FSYNC:
+      f->eax = (uint32_t) syscall_fsync ((int)*arg1);
+      break;
+    case SYS_SYNC:
+      filesys_sync ();
+      break;
+    case SYS_PREAD:
+      is_valid_buffer(f, *(void **)arg2, (unsigned)*arg3, true);
+      f->eax = (uint32_t) syscall_pread ((int)*arg1, *(void **)arg2, (unsigned)*arg3, (unsigned)*arg4);
+      break;
+    case SYS_PWRITE:
+      is_valid_buffer(f, *(void **)arg2, (unsigned)*arg3, false);
+      f->eax = (uint32_t) syscall_pwrite ((int)*arg1, *(void **)arg2, (unsigned)*arg3, (unsigned)*arg4);
+      break;
+    case SYS_READV:
+      if (is_valid_iovec(f, *(struct iovec **)arg2, (int)*arg3, true))
+        f->eax = (uint32_t) syscall_readv ((int)*arg1, *(struct iovec **)arg2, (int)*arg3);
+      else
+        f->eax = (uint32_t) -1;
+      break;
+    case SYS_WRITEV:
+      if (is_valid_iovec(f, *(struct iovec **)arg2, (int)*arg3, false))
+        f->eax = (uint32_t) syscall_writev ((int)*arg1, *(struct iovec **)arg2, (int)*arg3);
+      else
+        f->eax = (uint32_t) -1;
+      break;
+    case SYS_COPY_FILE_RANGE:
+      f->eax = (uint32_t) syscall_copy_file_range ((int)*arg1, (int)*arg2, (unsigned)*arg3);
+      break;
+    case SYS_PIPE:
+      is_valid_buffer(f, *(void **)arg1, 2 * sizeof (int), true);
+      f->eax = (uint32_t) syscall_pipe (*(int **)arg1);
+      break;
+    case SYS_DUP2:
+      f->eax = (uint32_t) syscall_dup2 ((int)*arg1, (int)*arg2);
+      break;
+    case SYS_GETDENTS:
+    {
+      unsigned cnt = (unsigned)*arg3 < GETDENTS_MAX ? (unsigned)*arg3 : GETDENTS_MAX;
+      is_valid_buffer(f, *(void **)arg2, cnt * sizeof (struct dirent), true);
+      f->eax = (uint32_t) syscall_getdents ((int)*arg1, *(struct dirent **)arg2, cnt);
+      break;
+    }
+    case SYS_FALLOCATE:
+      f->eax = (uint32_t) syscall_fallocate ((int)*arg1, (unsigned)*arg2, (int)*arg3);
+      break;
+    case SYS_DISKSTAT:
+      is_valid_buffer(f, *(void **)arg2, sizeof (struct disk_stat), true);
+      f->eax = (uint32_t) syscall_diskstat ((int)*arg1, *(struct disk_stat **)arg2);
+      break;
     default:
       break;
   }
@@ -252,6 +337,10 @@ static void
 is_valid_buffer (struct intr_frame *f UNUSED, void *uaddr, unsigned length, bool write)
 {
   void *position = uaddr;
+
+  // a buffer that wraps around the address space is never valid
+  if (uaddr + length < uaddr)
+    syscall_exit(EXIT_STATUS_1);
   
   while (pg_round_down(position) <= pg_round_down(uaddr + length))
   {
@@ -262,14 +351,48 @@ is_valid_buffer (struct intr_frame *f UNUSED, void *uaddr, unsigned length, bool
   return;
 }
 
+/* Checks the IOVCNT entries of IOV and every buffer they point
+   to, exiting on a bad address.  Returns false without reading
+   IOV if IOVCNT is outside 1...IOV_MAX, or if the buffers add up
+   to more than INT_MAX bytes. */
+static bool
+is_valid_iovec (struct intr_frame *f UNUSED, const struct iovec *iov, int iovcnt, bool write)
+{
+  size_t total = 0;
+  int i;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return false;
+
+  // the array itself has to be readable before any entry is used
+  is_valid_buffer (f, (void *) iov, iovcnt * sizeof *iov, false);
+  for (i = 0; i < iovcnt; i++)
+  {
+    if (iov[i].iov_len == 0)
+      continue;
+    if (iov[i].iov_len > INT_MAX - total)
+      return false;
+    total += iov[i].iov_len;
+    is_valid_buffer (f, iov[i].iov_base, iov[i].iov_len, write);
+  }
+  return true;
+}
+
 /************************************************************
 *      struct and function for file descriptor table.       *
 *************************************************************/
 
+/* A descriptor refers to an open file, a directory or one end
+   of a pipe, so exactly one of FILE, DIR and PIPE is non-null.
+   Descriptors 0 and 1 refer to the console unless dup2() has put
+   something else there. */
 struct file_descriptor
 {
   int fd;
   struct file* file;
+  struct dir* dir;
+  struct pipe* pipe;
+  bool pipe_write;            // write end of PIPE?
   struct list_elem elem;
 };
 
@@ -283,6 +406,47 @@ file_add_fdlist (struct file* file)
 
   desc->fd = curr->fd;
   desc->file = file;
+  desc->dir = NULL;
+  desc->pipe = NULL;
+  desc->pipe_write = false;
+
+  list_push_back (&curr->fd_list, &desc->elem);
+
+  return curr->fd;
+}
+
+static int
+pipe_add_fdlist (struct pipe* pipe, bool write_end)
+{
+  struct thread *curr = thread_current ();
+  struct file_descriptor *desc = malloc(sizeof (*desc));
+
+  curr->fd++;
+
+  desc->fd = curr->fd;
+  desc->file = NULL;
+  desc->dir = NULL;
+  desc->pipe = pipe;
+  desc->pipe_write = write_end;
+
+  list_push_back (&curr->fd_list, &desc->elem);
+
+  return curr->fd;
+}
+
+static int
+dir_add_fdlist (struct dir* dir)
+{
+  struct thread *curr = thread_current ();
+  struct file_descriptor *desc = malloc(sizeof (*desc));
+
+  curr->fd++;
+
+  desc->fd = curr->fd;
+  desc->file = NULL;
+  desc->dir = dir;
+  desc->pipe = NULL;
+  desc->pipe_write = false;
 
   list_push_back (&curr->fd_list, &desc->elem);
 
@@ -297,9 +461,7 @@ file_remove_fdlist (int fd)
   if (desc == NULL)
     return;
 
-  file_close (desc->file);
-  list_remove (&desc->elem);
-  free (desc);
+  fd_close (desc);
 }
 
 static struct file_descriptor *
@@ -318,7 +480,105 @@ fd_to_file_descriptor (int fd)
   return NULL;
 }
 
+/* Adds to T's table a descriptor FD that refers to the same
+   file or pipe end as OLD.  A duplicated file gets its own
+   position, starting where OLD's is. */
+static bool
+fd_dup (struct thread *t, const struct file_descriptor *old, int fd)
+{
+  struct file_descriptor *desc = malloc(sizeof (*desc));
+
+  if (desc == NULL)
+    return false;
+
+  desc->file = NULL;
+  desc->dir = NULL;
+  desc->pipe = old->pipe;
+  desc->pipe_write = old->pipe_write;
+  if (old->pipe != NULL)
+    pipe_reopen (old->pipe, old->pipe_write);
+  else if (old->dir != NULL)
+  {
+    desc->dir = dir_reopen (old->dir);
+    if (desc->dir == NULL)
+    {
+      free (desc);
+      return false;
+    }
+  }
+  else
+  {
+    desc->file = file_reopen (old->file);
+    if (desc->file == NULL)
+    {
+      free (desc);
+      return false;
+    }
+    file_seek (desc->file, file_tell (old->file));
+  }
+
+  desc->fd = fd;
+  if (t->fd < fd)
+    t->fd = fd;
+  list_push_back (&t->fd_list, &desc->elem);
+  return true;
+}
+
 static void
+fd_close (struct file_descriptor *desc)
+{
+  if (desc->pipe != NULL)
+    pipe_close (desc->pipe, desc->pipe_write);
+  else if (desc->dir != NULL)
+    dir_close (desc->dir);
+  else
+    file_close (desc->file);
+  list_remove (&desc->elem);
+  free (desc);
+}
+
+static int
+fd_read (struct file_descriptor *desc, void *buffer, unsigned length)
+{
+  if (desc->pipe != NULL)
+    return desc->pipe_write ? -1 : pipe_read (desc->pipe, buffer, length);
+  if (desc->file == NULL)
+    return -1;
+  return file_read (desc->file, buffer, length);
+}
+
+static int
+fd_write (struct file_descriptor *desc, const void *buffer, unsigned length)
+{
+  if (desc->pipe != NULL)
+    return desc->pipe_write ? pipe_write (desc->pipe, buffer, length) : -1;
+  if (desc->file == NULL)
+    return -1;
+  return file_write (desc->file, buffer, length);
+}
+
+/* Gives the current thread, a process being started by PARENT,
+   a copy of PARENT's standard input and output if they are
+   pipes, so that a shell can connect the processes it starts.
+   Other descriptors are not inherited: a child holding a copy of
+   the other end of its own pipe would keep the pipe from ever
+   seeing its last reader or writer leave.  PARENT must be waiting
+   for the load to finish. */
+void
+syscall_inherit_fds (struct thread *parent)
+{
+  struct list_elem *iter;
+  struct file_descriptor *desc;
+
+  for (iter = list_begin (&parent->fd_list); iter != list_end (&parent->fd_list); iter = list_next (iter))
+  {
+    desc = list_entry(iter, struct file_descriptor, elem);
+    if (desc->pipe != NULL && (desc->fd == STDIN_FILENO || desc->fd == STDOUT_FILENO))
+      fd_dup (thread_current (), desc, desc->fd);
+  }
+}
+
+void
 process_remove_fdlist (struct thread* t)
 {
   struct list_elem *iter, *iter_2;
@@ -333,9 +593,7 @@ process_remove_fdlist (struct thread* t)
 
     desc = list_entry(iter, struct file_descriptor, elem);
 
-    file_close (desc->file);
-    list_remove (&desc->elem);
-    free (desc);
+    fd_close (desc);
 
     iter = iter_2;
   }
@@ -384,125 +642,343 @@ syscall_create (char *file, off_t initial_size)
 static int
 syscall_open (char *file)
 {
-  lock_acquire(&lock_file);
   struct file* opened_file = filesys_open (file);
+  struct dir* opened_dir;
+
+  if (opened_file != NULL)
+    return file_add_fdlist(opened_file);
 
-  if (opened_file == NULL)
+  opened_dir = filesys_open_dir (file);
+  if (opened_dir == NULL)
     return -1;
 
-  int result = file_add_fdlist(opened_file);
-  lock_release(&lock_file);
-  return result;
+  return dir_add_fdlist(opened_dir);
 }
 
 static void
 syscall_close (int fd)
 {
-  lock_acquire(&lock_file);
   file_remove_fdlist (fd);
-  lock_release(&lock_file);
 }
 
 static int
 syscall_read (int fd, void *buffer, unsigned length)
 {
-  if (fd == 0) /* STDIN */
-    return input_getc();
-
-  lock_acquire(&lock_file);
-
   struct file_descriptor *desc = fd_to_file_descriptor(fd);
 
-  if (desc == NULL)
+  if (desc == NULL && fd == 0) /* STDIN */
   {
-    lock_release(&lock_file);
-    return -1;
+    uint8_t *buf = buffer;
+    unsigned i;
+
+    for (i = 0; i < length; i++)
+      buf[i] = input_getc();
+    return length;
   }
 
-  int result = file_read (desc->file, buffer, length);
+  if (desc == NULL)
+    return -1;
 
-  lock_release(&lock_file);
-  return result;
+  return fd_read (desc, buffer, length);
 }
 
 static int
 syscall_filesize (int fd)
 {
-  lock_acquire(&lock_file);
   struct file_descriptor *desc = fd_to_file_descriptor(fd);
-  int result = file_length(desc->file);
 
-  lock_release(&lock_file);
-  return result;
+  if (desc == NULL || desc->file == NULL)
+    return -1;
+
+  return file_length(desc->file);
 }
 
 static int
 syscall_write (int fd, void *buffer, unsigned size)
 {
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
 
-  if (fd == 1) /* STDOUT */
+  if (desc == NULL && fd == 1) /* STDOUT */
   {
     putbuf (buffer, size);
     return size;
   }
 
-  lock_acquire(&lock_file);
-
-  struct file_descriptor *desc = fd_to_file_descriptor(fd);
-
   if (desc == NULL)
-  {
-    lock_release(&lock_file);
     return -1;
-  }
-
-  int result = file_write (desc->file, buffer, size);
 
-  lock_release(&lock_file);
-  return result;
+  return fd_write (desc, buffer, size);
 }
 
 static bool
 syscall_remove (const char *file)
 {
-  lock_acquire(&lock_file);
-  bool result = filesys_remove (file);
-  lock_release(&lock_file);
-
-  return result;
+  return filesys_remove (file);
 }
 
 static void
 syscall_seek (int fd, unsigned position)
 {
-  lock_acquire(&lock_file);
-
   struct file_descriptor *desc = fd_to_file_descriptor(fd);
 
-  if (desc == NULL)
-  {
-    lock_release(&lock_file);
-  }
+  if (desc == NULL || desc->file == NULL)
+    return;
 
   file_seek (desc->file, position);
-  lock_release(&lock_file);
 }
 
 static unsigned
 syscall_tell (int fd)
 {
-  lock_acquire(&lock_file);
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+
+  if (desc == NULL || desc->file == NULL)
+    return 0; //todo: error handling right?
+
+  return file_tell (desc->file);
+}
 
+static int
+syscall_fsync (int fd)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+
+  if (desc == NULL || desc->file == NULL)
+    return -1;
+
+  file_sync (desc->file);
+  return 0;
+}
+
+/* pread and pwrite go straight to the inode at OFFSET, leaving
+   the file position alone, so one call replaces a seek and a
+   read or write. */
+static int
+syscall_pread (int fd, void *buffer, unsigned length, unsigned offset)
+{
   struct file_descriptor *desc = fd_to_file_descriptor(fd);
 
+  if (desc == NULL || desc->file == NULL || (off_t) offset < 0)
+    return -1;
+
+  return file_read_at (desc->file, buffer, length, offset);
+}
+
+static int
+syscall_pwrite (int fd, const void *buffer, unsigned length, unsigned offset)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+
+  if (desc == NULL || desc->file == NULL || (off_t) offset < 0)
+    return -1;
+
+  return file_write_at (desc->file, buffer, length, offset);
+}
+
+/* readv and writev move the buffers of IOV in order, starting at
+   the file position, and stop at the first short transfer. */
+static int
+syscall_readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  int total = 0;
+  int i;
+
+  if (desc == NULL || iovcnt <= 0 || iovcnt > IOV_MAX)
+    return -1;
+
+  for (i = 0; i < iovcnt; i++)
+  {
+    int cnt = fd_read (desc, iov[i].iov_base, iov[i].iov_len);
+    if (cnt < 0)
+      return total > 0 ? total : -1;
+    total += cnt;
+    if (cnt < (int) iov[i].iov_len)
+      break;
+  }
+  return total;
+}
+
+static int
+syscall_writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  int total = 0;
+  int i;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return -1;
+
+  if (desc == NULL && fd == 1) /* STDOUT */
+  {
+    for (i = 0; i < iovcnt; i++)
+    {
+      putbuf (iov[i].iov_base, iov[i].iov_len);
+      total += iov[i].iov_len;
+    }
+    return total;
+  }
+
   if (desc == NULL)
+    return -1;
+
+  for (i = 0; i < iovcnt; i++)
   {
-    lock_release(&lock_file);
-    return 0; //todo: error handling right?
+    int cnt = fd_write (desc, iov[i].iov_base, iov[i].iov_len);
+    if (cnt < 0)
+      return total > 0 ? total : -1;
+    total += cnt;
+    if (cnt < (int) iov[i].iov_len)
+      break;
   }
+  return total;
+}
+
+/* Copies LENGTH bytes between two open files inside the kernel,
+   so no user buffer has to be checked or filled.  Both file
+   positions advance.  A copy within one file must not overlap
+   itself. */
+static int
+syscall_copy_file_range (int in_fd, int out_fd, unsigned length)
+{
+  struct file_descriptor *in = fd_to_file_descriptor(in_fd);
+  struct file_descriptor *out = fd_to_file_descriptor(out_fd);
 
-  unsigned result = file_tell (desc->file);
-  lock_release(&lock_file);
+  if (in == NULL || out == NULL || in->file == NULL || out->file == NULL
+      || (off_t) length < 0)
+    return -1;
 
-  return result;
+  if (file_get_inode (in->file) == file_get_inode (out->file))
+  {
+    off_t in_pos = file_tell (in->file);
+    off_t out_pos = file_tell (out->file);
+    off_t left = file_length (in->file) - in_pos;
+
+    // only the bytes the source still has are copied; comparing
+    // the gap between the positions with them cannot overflow
+    if (left < 0)
+      left = 0;
+    if ((off_t) length > left)
+      length = left;
+    if (in_pos <= out_pos ? out_pos - in_pos < (off_t) length
+                          : in_pos - out_pos < (off_t) length)
+      return -1;
+  }
+
+  return file_copy (out->file, in->file, length);
+}
+
+/* Creates a pipe and stores a descriptor for its read end in
+   FDS[0] and one for its write end in FDS[1]. */
+static int
+syscall_pipe (int *fds)
+{
+  struct pipe *pipe = pipe_create ();
+
+  if (pipe == NULL)
+    return -1;
+
+  fds[0] = pipe_add_fdlist (pipe, false);
+  fds[1] = pipe_add_fdlist (pipe, true);
+  return 0;
+}
+
+/* Makes NEWFD refer to what OLDFD refers to, closing NEWFD
+   first if it is open.  Closing a redirected 0 or 1 later gives
+   the console back. */
+static int
+syscall_dup2 (int oldfd, int newfd)
+{
+  struct file_descriptor *old = fd_to_file_descriptor(oldfd);
+
+  if (old == NULL || newfd < 0)
+    return -1;
+  if (oldfd == newfd)
+    return newfd;
+
+  file_remove_fdlist (newfd);
+  if (!fd_dup (thread_current (), old, newfd))
+    return -1;
+  return newfd;
+}
+
+/* Fills ENTS with up to CNT entries of directory FD, where CNT
+   is at most GETDENTS_MAX, and returns how many it stored: 0 at
+   the end of the directory, -1 if FD is not a directory.  The
+   entries are gathered in a kernel page so that no directory
+   lock is held while user memory is touched. */
+static int
+syscall_getdents (int fd, struct dirent *ents, unsigned cnt)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+  struct dirent *page;
+  size_t n;
+
+  if (desc == NULL || desc->dir == NULL)
+    return -1;
+
+  page = palloc_get_page (0);
+  if (page == NULL)
+    return -1;
+
+  ASSERT (cnt <= GETDENTS_MAX);
+  n = dir_readdir_many (desc->dir, page, cnt);
+  memcpy (ents, page, n * sizeof *ents);
+  palloc_free_page (page);
+  return n;
+}
+
+static bool
+syscall_isdir (int fd)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+
+  return desc != NULL && desc->dir != NULL;
+}
+
+static int
+syscall_inumber (int fd)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+
+  if (desc == NULL || desc->pipe != NULL)
+    return -1;
+
+  if (desc->dir != NULL)
+    return inode_get_inumber (dir_get_inode (desc->dir));
+  return inode_get_inumber (file_get_inode (desc->file));
+}
+
+/* Reserves contiguous space for the first LENGTH bytes of file
+   FD, leaving its size alone, so that a writer that knows how
+   much it will write gets sequential sectors up front.  With
+   FALLOC_ZERO in FLAGS, also extends the file to LENGTH bytes
+   and writes zeros to disk for every byte not yet written. */
+static int
+syscall_fallocate (int fd, unsigned length, int flags)
+{
+  struct file_descriptor *desc = fd_to_file_descriptor(fd);
+
+  if (desc == NULL || desc->file == NULL || (off_t) length < 0
+      || (flags & ~FALLOC_ZERO) != 0)
+    return -1;
+
+  return file_reserve (desc->file, length, (flags & FALLOC_ZERO) != 0) ? 0 : -1;
+}
+
+/* Copies the statistics of disk DISK_NO, counting the ATA disks
+   that are present and then any others, into STAT.  The copy is
+   taken into kernel memory first, because the disk layer takes
+   it with interrupts off and a user page may need to be faulted
+   in. */
+static int
+syscall_diskstat (int disk_no, struct disk_stat *stat)
+{
+  struct disk_stat copy;
+
+  if (disk_no < 0 || !disk_get_stat (disk_no, &copy))
+    return -1;
+
+  memcpy (stat, &copy, sizeof copy);
+  return 0;
 }
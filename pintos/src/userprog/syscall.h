@@ -4,4 +4,8 @@
 void syscall_init (void);
 void syscall_exit (int status);
 
+struct thread;
+void syscall_inherit_fds (struct thread *parent);
+void process_remove_fdlist (struct thread *);
+
 #endif /* userprog/syscall.h */
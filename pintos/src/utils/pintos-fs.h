@@ -0,0 +1,120 @@
+#ifndef UTILS_PINTOS_FS_H
+#define UTILS_PINTOS_FS_H
+
+/* On-disk format of the Pintos file system, for host tools that
+   read or write file system disks directly.
+
+   These definitions mirror filesys/filesys.h, filesys/inode.c,
+   filesys/directory.c, filesys/journal.c and filesys/free-map.c,
+   and must be kept in sync with them.  Pintos runs on a
+   little-endian 32-bit machine, so the structures below assume a
+   little-endian host and use fixed-width types where Pintos uses
+   int, unsigned or off_t. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Size of a disk sector in bytes. */
+#define FS_SECTOR_SIZE 512
+
+/* Fixed sectors. */
+#define FS_FREE_MAP_SECTOR 0    /* Free map file inode sector. */
+#define FS_ROOT_DIR_SECTOR 1    /* Root directory file inode sector. */
+#define FS_JOURNAL_SECTOR 2     /* Journal superblock. */
+#define FS_JOURNAL_SECTORS 256  /* Sectors reserved for the journal. */
+
+/* First sector not reserved by the layout above. */
+#define FS_FIRST_FREE_SECTOR (FS_JOURNAL_SECTOR + FS_JOURNAL_SECTORS)
+
+/* The file system uses at most this many sectors of its disk,
+   as FREE_MAP_MAX_SECTORS; the rest of a larger disk is unused. */
+#define FS_MAX_SECTORS (2 * 1024 * 1024)
+
+/* Entries in the root directory, as passed to dir_create(). */
+#define FS_ROOT_DIR_ENTRIES 200
+
+/* Maximum length of a file name component. */
+#define FS_NAME_MAX 14
+
+/* Inode. */
+#define FS_INODE_MAGIC 0x494e4f44
+#define FS_INODE_INLINE_SIZE 488
+#define FS_INODE_INLINE 0x1
+
+struct fs_inode
+  {
+    uint32_t start;                     /* First data sector. */
+    uint32_t sector_cnt;                /* Number of data sectors. */
+    int32_t length;                     /* File size in bytes. */
+    int32_t valid_length;               /* Bytes of data written so far. */
+    uint32_t magic;                     /* FS_INODE_MAGIC. */
+    uint32_t flags;                     /* FS_INODE_* flags. */
+    uint8_t inline_data[FS_INODE_INLINE_SIZE]; /* Data if inline. */
+  };
+
+/* Directory entry. */
+struct fs_dir_entry
+  {
+    uint32_t inode_sector;              /* Sector number of header. */
+    char name[FS_NAME_MAX + 1];         /* Null terminated file name. */
+    uint8_t in_use;                     /* In use or free? */
+  };
+
+/* Hashed directory bucket. */
+#define FS_DIR_BUCKET_MAGIC 0x48534944
+#define FS_DIR_BUCKET_ENTRIES 25
+
+struct fs_dir_bucket
+  {
+    uint32_t magic;                     /* FS_DIR_BUCKET_MAGIC. */
+    uint16_t used_cnt;                  /* Number of entries in use. */
+    uint8_t free_hint;                  /* Probably-free slot index. */
+    uint8_t unused;                     /* Not used. */
+    uint32_t overflow_cnt;              /* Entries homed here, stored later. */
+    struct fs_dir_entry entries[FS_DIR_BUCKET_ENTRIES];
+  };
+
+/* Journal header sector. */
+#define FS_JOURNAL_MAGIC 0x4c4e524a
+
+enum fs_journal_type
+  {
+    FS_JOURNAL_SUPER,                   /* Superblock. */
+    FS_JOURNAL_DESCRIPTOR,              /* Start of a transaction. */
+    FS_JOURNAL_COMMIT                   /* End of a transaction. */
+  };
+
+struct fs_journal_header
+  {
+    uint32_t magic;                     /* FS_JOURNAL_MAGIC. */
+    uint32_t type;                      /* An FS_JOURNAL_* type. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Number of sectors logged. */
+    uint32_t sectors[124];              /* Home sectors of logged data. */
+  };
+
+/* Returns the number of bytes in the free map file of a disk
+   with SECTOR_CNT sectors.  The free map has one bit per sector,
+   stored as an array of 32-bit words, least significant bit
+   first. */
+static inline uint32_t
+fs_free_map_size (uint32_t sector_cnt)
+{
+  return (sector_cnt + 31) / 32 * 4;
+}
+
+/* Returns the bucket in which NAME belongs in a hashed directory
+   with BUCKET_CNT buckets, using the same 32-bit Fowler-Noll-Vo
+   hash as hash_string() in lib/kernel/hash.c. */
+static inline uint32_t
+fs_bucket_home (const char *name, uint32_t bucket_cnt)
+{
+  const unsigned char *s = (const unsigned char *) name;
+  uint32_t hash = 2166136261u;
+
+  while (*s != '\0')
+    hash = (hash * 16777619u) ^ *s++;
+  return hash % bucket_cnt;
+}
+
+#endif /* utils/pintos-fs.h */
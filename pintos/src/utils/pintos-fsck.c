@@ -0,0 +1,572 @@
+/* pintos-fsck, a utility for checking a Pintos file system disk
+   and reporting statistics about its layout, without booting
+   Pintos.
+
+   Checks that every inode and directory is well formed, that no
+   sector is used twice, and that the free map marks exactly the
+   sectors in use.  Also reports how full and fragmented the free
+   space is and, optionally, where each file lives on disk. */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "pintos-fs.h"
+
+static void
+fail_io (const char *msg, ...)
+     __attribute__ ((noreturn))
+     __attribute__ ((format (printf, 1, 2)));
+
+static void problem (const char *msg, ...)
+     __attribute__ ((format (printf, 1, 2)));
+
+/* Prints MSG, formatting as with printf(),
+   plus an error message based on errno,
+   and exits. */
+static void
+fail_io (const char *msg, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-fsck: ");
+  va_start (args, msg);
+  vfprintf (stderr, msg, args);
+  va_end (args);
+
+  if (errno != 0)
+    fprintf (stderr, ": %s", strerror (errno));
+  putc ('\n', stderr);
+  exit (2);
+}
+
+/* Returns the number of sectors needed to hold SIZE bytes. */
+static uint32_t
+bytes_to_sectors (uint32_t size)
+{
+  return (size + FS_SECTOR_SIZE - 1) / FS_SECTOR_SIZE;
+}
+
+/* The disk being checked. */
+static const char *disk_name;
+static int disk_fd;
+static uint32_t disk_sectors;
+
+/* Number of problems found. */
+static unsigned problem_cnt;
+
+/* Reports a problem with the file system. */
+static void
+problem (const char *msg, ...)
+{
+  va_list args;
+
+  printf ("%s: ", disk_name);
+  va_start (args, msg);
+  vprintf (msg, args);
+  va_end (args);
+  putchar ('\n');
+  problem_cnt++;
+}
+
+/* Reads SIZE bytes starting at SECTOR into BUF. */
+static void
+read_sectors (uint32_t sector, void *buf, uint32_t size)
+{
+  off_t ofs = (off_t) sector * FS_SECTOR_SIZE;
+
+  if (pread (disk_fd, buf, size, ofs) != (ssize_t) size)
+    fail_io ("%s: read", disk_name);
+}
+
+/* What each sector is used for. */
+enum use
+  {
+    USE_FREE,                   /* Not referenced. */
+    USE_RESERVED,               /* Fixed sector. */
+    USE_META,                   /* Free map or directory data. */
+    USE_INODE,                  /* Inode. */
+    USE_DATA                    /* File data. */
+  };
+static uint8_t *sector_use;
+
+/* Records that CNT sectors starting at SECTOR are used for USE by
+   WHAT.  Returns false, after reporting the problem, if they do
+   not lie within the disk or are already in use. */
+static bool
+claim (uint32_t sector, uint32_t cnt, enum use use, const char *what)
+{
+  uint32_t i;
+
+  if (sector >= disk_sectors || cnt > disk_sectors - sector)
+    {
+      problem ("%s: sectors %u+%u beyond end of disk", what, sector, cnt);
+      return false;
+    }
+  for (i = 0; i < cnt; i++)
+    if (sector_use[sector + i] != USE_FREE)
+      {
+        problem ("%s: sector %u already in use", what, sector + i);
+        return false;
+      }
+  memset (sector_use + sector, use, cnt);
+  return true;
+}
+
+/* Statistics. */
+static unsigned file_cnt;               /* Files in the root directory. */
+static unsigned inline_cnt;             /* Files stored inline. */
+static unsigned long long file_bytes;   /* Sum of file lengths. */
+static unsigned long long slack_sectors; /* Allocated past length. */
+static unsigned far_cnt;                /* Files whose data is not
+                                           right after their inode. */
+
+/* Reads the inode at SECTOR into *INODE and checks it, claiming
+   its data sectors for USE.  Returns false if it is too broken to
+   read the data of. */
+static bool
+check_inode (uint32_t sector, struct fs_inode *inode, enum use use,
+             const char *what)
+{
+  read_sectors (sector, inode, sizeof *inode);
+  if (inode->magic != FS_INODE_MAGIC)
+    {
+      problem ("%s: inode %u has bad magic %08x", what, sector, inode->magic);
+      return false;
+    }
+  if (inode->length < 0 || inode->valid_length < 0
+      || inode->valid_length > inode->length)
+    {
+      problem ("%s: inode %u has bad length %d (%d valid)",
+               what, sector, inode->length, inode->valid_length);
+      return false;
+    }
+  if (inode->flags & FS_INODE_INLINE)
+    {
+      if (inode->length > FS_INODE_INLINE_SIZE)
+        {
+          problem ("%s: inline inode %u too long (%d bytes)",
+                   what, sector, inode->length);
+          return false;
+        }
+      if (inode->valid_length != inode->length)
+        problem ("%s: inline inode %u has only %d of %d bytes valid",
+                 what, sector, inode->valid_length, inode->length);
+      return true;
+    }
+  if (inode->sector_cnt < bytes_to_sectors (inode->length))
+    {
+      problem ("%s: inode %u has %u sectors for %d bytes",
+               what, sector, inode->sector_cnt, inode->length);
+      return false;
+    }
+  return inode->sector_cnt == 0
+         || claim (inode->start, inode->sector_cnt, use, what);
+}
+
+/* Reads the data of the file whose inode is INODE into a newly
+   allocated buffer.  Bytes past the valid length read as zeros. */
+static void *
+read_inode_data (const struct fs_inode *inode)
+{
+  uint8_t *data = calloc (1, bytes_to_sectors (inode->length)
+                             * FS_SECTOR_SIZE + 1);
+  if (data == NULL)
+    fail_io ("out of memory");
+  if (inode->flags & FS_INODE_INLINE)
+    memcpy (data, inode->inline_data, inode->length);
+  else if (inode->valid_length > 0)
+    {
+      read_sectors (inode->start, data,
+                    bytes_to_sectors (inode->valid_length) * FS_SECTOR_SIZE);
+      memset (data + inode->valid_length, 0,
+              bytes_to_sectors (inode->length) * FS_SECTOR_SIZE
+              - inode->valid_length);
+    }
+  return data;
+}
+
+/* Per-file layout is printed if true. */
+static bool verbose;
+
+/* Checks the file named NAME whose inode is at SECTOR. */
+static void
+check_file (const char *name, uint32_t sector)
+{
+  struct fs_inode inode;
+  char what[64];
+
+  snprintf (what, sizeof what, "file \"%s\"", name);
+  if (!claim (sector, 1, USE_INODE, what)
+      || !check_inode (sector, &inode, USE_DATA, what))
+    return;
+
+  file_cnt++;
+  file_bytes += inode.length;
+  if (inode.flags & FS_INODE_INLINE)
+    inline_cnt++;
+  else
+    {
+      slack_sectors += inode.sector_cnt - bytes_to_sectors (inode.length);
+      if (inode.sector_cnt > 0 && inode.start != sector + 1)
+        far_cnt++;
+    }
+
+  if (verbose)
+    {
+      if (inode.flags & FS_INODE_INLINE)
+        printf ("  %-14s %8u %10d  inline\n", name, sector, inode.length);
+      else
+        printf ("  %-14s %8u %10d  %8u+%-6u %s\n",
+                name, sector, inode.length, inode.start, inode.sector_cnt,
+                inode.valid_length < inode.length ? " (sparse)" : "");
+    }
+}
+
+/* Returns true if entry E has a properly terminated, nonempty
+   name, reporting a problem otherwise. */
+static bool
+check_entry_name (const struct fs_dir_entry *e, const char *where)
+{
+  if (memchr (e->name, '\0', sizeof e->name) == NULL || e->name[0] == '\0')
+    {
+      problem ("root directory: %s has a bad name", where);
+      return false;
+    }
+  return true;
+}
+
+/* Names seen so far in the root directory, to detect
+   duplicates. */
+static char (*names)[FS_NAME_MAX + 1];
+static size_t name_cnt;
+
+/* Checks entry E of the root directory and the file it names.
+   Returns false if E's name is unusable. */
+static bool
+check_entry (const struct fs_dir_entry *e, const char *where)
+{
+  size_t i;
+
+  if (!check_entry_name (e, where))
+    return false;
+  for (i = 0; i < name_cnt; i++)
+    if (!strcmp (names[i], e->name))
+      {
+        problem ("root directory: \"%s\" appears twice", e->name);
+        return true;
+      }
+  strcpy (names[name_cnt++], e->name);
+  check_file (e->name, e->inode_sector);
+  return true;
+}
+
+/* Checks the root directory, whose contents are DATA, LENGTH
+   bytes long, and every file in it. */
+static void
+check_root (const uint8_t *data, int32_t length)
+{
+  const struct fs_dir_bucket *buckets = (const void *) data;
+  char where[64];
+
+  names = calloc (length / sizeof (struct fs_dir_entry) + 1, sizeof *names);
+  if (names == NULL)
+    fail_io ("out of memory");
+
+  if (verbose)
+    printf ("  %-14s %8s %10s  %s\n", "NAME", "INODE", "LENGTH", "DATA");
+
+  if (length >= FS_SECTOR_SIZE && length % FS_SECTOR_SIZE == 0
+      && buckets[0].magic == FS_DIR_BUCKET_MAGIC)
+    {
+      /* Hashed directory: also check each bucket's counts, which
+         lookups rely on to know when to stop probing. */
+      uint32_t bucket_cnt = length / FS_SECTOR_SIZE;
+      uint32_t *overflow = calloc (bucket_cnt, sizeof *overflow);
+      uint32_t i, j;
+
+      if (overflow == NULL)
+        fail_io ("out of memory");
+      for (i = 0; i < bucket_cnt; i++)
+        {
+          const struct fs_dir_bucket *b = &buckets[i];
+          unsigned used = 0;
+
+          if (b->magic != FS_DIR_BUCKET_MAGIC)
+            {
+              problem ("root directory: bucket %u has bad magic %08x",
+                       i, b->magic);
+              continue;
+            }
+          for (j = 0; j < FS_DIR_BUCKET_ENTRIES; j++)
+            if (b->entries[j].in_use)
+              {
+                const struct fs_dir_entry *e = &b->entries[j];
+                snprintf (where, sizeof where, "bucket %u entry %u", i, j);
+                used++;
+                if (check_entry (e, where))
+                  {
+                    uint32_t home = fs_bucket_home (e->name, bucket_cnt);
+                    if (home != i)
+                      overflow[home]++;
+                  }
+              }
+          if (used != b->used_cnt)
+            problem ("root directory: bucket %u has %u entries, "
+                     "but counts %u", i, used, b->used_cnt);
+        }
+      for (i = 0; i < bucket_cnt; i++)
+        if (buckets[i].magic == FS_DIR_BUCKET_MAGIC
+            && overflow[i] != buckets[i].overflow_cnt)
+          problem ("root directory: bucket %u has %u overflowed entries, "
+                   "but counts %u", i, overflow[i], buckets[i].overflow_cnt);
+      free (overflow);
+    }
+  else
+    {
+      /* Linear directory. */
+      const struct fs_dir_entry *entries = (const void *) data;
+      size_t i;
+
+      for (i = 0; i < length / sizeof *entries; i++)
+        if (entries[i].in_use)
+          {
+            snprintf (where, sizeof where, "entry %zu", i);
+            check_entry (&entries[i], where);
+          }
+    }
+  free (names);
+}
+
+/* Checks the journal, returning false if it holds transactions
+   that Pintos would replay when mounting the disk.  This tool
+   does not replay them itself, so the rest of the disk may look
+   inconsistent until then. */
+static bool
+check_journal (void)
+{
+  struct fs_journal_header h;
+  uint32_t seq;
+
+  read_sectors (FS_JOURNAL_SECTOR, &h, sizeof h);
+  if (h.magic != FS_JOURNAL_MAGIC || h.type != FS_JOURNAL_SUPER)
+    {
+      problem ("no journal superblock (not a Pintos file system?)");
+      return true;
+    }
+  seq = h.seq;
+  read_sectors (FS_JOURNAL_SECTOR + 1, &h, sizeof h);
+  if (h.magic == FS_JOURNAL_MAGIC && h.type == FS_JOURNAL_DESCRIPTOR
+      && h.seq == seq)
+    {
+      printf ("Journal: transactions pending replay from sequence %u\n",
+              seq);
+      return false;
+    }
+  printf ("Journal: clean, sequence %u\n", seq);
+  return true;
+}
+
+/* Compares the free map, whose contents are FREE_MAP, against the
+   sectors found in use, and reports free space statistics. */
+static void
+check_free_map (const uint8_t *free_map)
+{
+  /* Free extent histogram, by powers of 2. */
+  enum { BUCKETS = 32 };
+  unsigned long extents[BUCKETS];
+  unsigned long long free_cnt = 0, extent_cnt = 0, largest = 0;
+  unsigned long leaked = 0, unmarked = 0;
+  uint32_t sector, run = 0;
+  int i;
+
+  memset (extents, 0, sizeof extents);
+  for (sector = 0; sector <= disk_sectors; sector++)
+    {
+      bool marked = (sector < disk_sectors
+                     && (free_map[sector / 8] >> (sector % 8)) & 1);
+
+      if (sector < disk_sectors)
+        {
+          if (marked && sector_use[sector] == USE_FREE)
+            {
+              if (leaked++ < 10)
+                problem ("sector %u marked in use but not referenced",
+                         sector);
+            }
+          else if (!marked && sector_use[sector] != USE_FREE)
+            {
+              if (unmarked++ < 10)
+                problem ("sector %u in use but marked free", sector);
+            }
+        }
+
+      if (sector < disk_sectors && !marked)
+        {
+          run++;
+          free_cnt++;
+        }
+      else if (run > 0)
+        {
+          for (i = 0; (2ul << i) <= run; i++)
+            continue;
+          extents[i]++;
+          extent_cnt++;
+          if (run > largest)
+            largest = run;
+          run = 0;
+        }
+    }
+  if (leaked > 10)
+    problem ("%lu sectors marked in use but not referenced", leaked);
+  if (unmarked > 10)
+    problem ("%lu sectors in use but marked free", unmarked);
+
+  printf ("Free space: %llu sectors in %llu extents, largest %llu",
+          free_cnt, extent_cnt, largest);
+  if (free_cnt > 0)
+    printf (", fragmentation %.1f%%",
+            100.0 * (free_cnt - largest) / free_cnt);
+  putchar ('\n');
+  if (extent_cnt > 0)
+    printf ("  %-14s %s\n", "SECTORS", "EXTENTS");
+  for (i = 0; i < BUCKETS; i++)
+    if (extents[i] > 0)
+      {
+        char range[32];
+        if (i == 0)
+          snprintf (range, sizeof range, "1");
+        else
+          snprintf (range, sizeof range, "%lu-%lu", 1ul << i,
+                    (2ul << i) - 1);
+        printf ("  %-14s %lu\n", range, extents[i]);
+      }
+}
+
+/* Checks the whole file system. */
+static void
+check (void)
+{
+  struct fs_inode free_map_inode, root_inode;
+  uint8_t *free_map = NULL, *root = NULL;
+  unsigned long cnt[USE_DATA + 1];
+  uint32_t sector;
+
+  sector_use = calloc (disk_sectors, 1);
+  if (sector_use == NULL)
+    fail_io ("out of memory");
+  claim (FS_FREE_MAP_SECTOR, 1, USE_RESERVED, "free map");
+  claim (FS_ROOT_DIR_SECTOR, 1, USE_RESERVED, "root directory");
+  claim (FS_JOURNAL_SECTOR, FS_JOURNAL_SECTORS, USE_RESERVED, "journal");
+
+  printf ("%s: %u sectors (%.1f MB)\n", disk_name, disk_sectors,
+          disk_sectors / 2048.0);
+  if (!check_journal ())
+    printf ("Boot Pintos once to replay the journal, then check again.\n");
+
+  if (check_inode (FS_FREE_MAP_SECTOR, &free_map_inode, USE_META,
+                   "free map"))
+    {
+      if ((uint32_t) free_map_inode.length < fs_free_map_size (disk_sectors))
+        problem ("free map: %d bytes, but disk needs %u",
+                 free_map_inode.length, fs_free_map_size (disk_sectors));
+      else
+        free_map = read_inode_data (&free_map_inode);
+    }
+  if (check_inode (FS_ROOT_DIR_SECTOR, &root_inode, USE_META,
+                   "root directory"))
+    {
+      root = read_inode_data (&root_inode);
+      check_root (root, root_inode.length);
+    }
+
+  memset (cnt, 0, sizeof cnt);
+  for (sector = 0; sector < disk_sectors; sector++)
+    cnt[sector_use[sector]]++;
+  printf ("Files: %u (%u inline), %llu bytes\n",
+          file_cnt, inline_cnt, file_bytes);
+  printf ("Sectors: %lu reserved, %lu metadata, %lu inodes, %lu data, "
+          "%lu unreferenced\n", cnt[USE_RESERVED], cnt[USE_META],
+          cnt[USE_INODE], cnt[USE_DATA], cnt[USE_FREE]);
+  printf ("Layout: %llu data sectors allocated past end of file, "
+          "%u of %u runs not right after their inode\n",
+          slack_sectors, far_cnt, file_cnt - inline_cnt);
+  if (free_map != NULL)
+    check_free_map (free_map);
+
+  free (free_map);
+  free (root);
+  free (sector_use);
+}
+
+static void
+usage (int exit_code)
+{
+  printf ("pintos-fsck, a utility for checking Pintos file system disks\n"
+          "Usage: pintos-fsck [-v] DISKFILE\n"
+          "where DISKFILE is the file system disk to check.\n"
+          "Exits with status 0 if no problems were found, 1 otherwise.\n"
+          "Options:\n"
+          "  -v, --verbose     List each file's inode and data sectors.\n"
+          "  -h, --help        Display this help message.\n");
+  exit (exit_code);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct stat st;
+  int i;
+
+  assert (sizeof (struct fs_inode) == FS_SECTOR_SIZE);
+  assert (sizeof (struct fs_dir_bucket) == FS_SECTOR_SIZE);
+  assert (sizeof (struct fs_journal_header) == FS_SECTOR_SIZE);
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    if (!strcmp (argv[i], "-v") || !strcmp (argv[i], "--verbose"))
+      verbose = true;
+    else if (!strcmp (argv[i], "-h") || !strcmp (argv[i], "--help"))
+      usage (EXIT_SUCCESS);
+    else
+      usage (2);
+  if (i != argc - 1)
+    usage (2);
+
+  disk_name = argv[i];
+  disk_fd = open (disk_name, O_RDONLY);
+  if (disk_fd < 0)
+    fail_io ("%s: open", disk_name);
+  if (fstat (disk_fd, &st) < 0)
+    fail_io ("%s: stat", disk_name);
+  if (st.st_size / FS_SECTOR_SIZE > UINT32_MAX)
+    {
+      errno = 0;
+      fail_io ("%s: disk too large", disk_name);
+    }
+  disk_sectors = st.st_size / FS_SECTOR_SIZE;
+  if (disk_sectors < FS_FIRST_FREE_SECTOR)
+    {
+      errno = 0;
+      fail_io ("%s: disk too small for a file system", disk_name);
+    }
+  if (disk_sectors > FS_MAX_SECTORS)
+    disk_sectors = FS_MAX_SECTORS;
+
+  check ();
+  close (disk_fd);
+
+  if (problem_cnt > 0)
+    {
+      printf ("%s: %u problems found\n", disk_name, problem_cnt);
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
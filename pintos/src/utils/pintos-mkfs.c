@@ -0,0 +1,386 @@
+/* pintos-mkfs, a utility for formatting a Pintos file system disk
+   and copying host files into it, without booting Pintos.
+
+   The disk must already exist, e.g. created with pintos-mkdisk.
+   The result is the same file system that "pintos -f" followed by
+   "pintos -p FILE -a NAME" for each file would produce, except
+   that the data of each file is laid out contiguously right after
+   its inode in the order given. */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "pintos-fs.h"
+
+static void
+fail (const char *msg, ...)
+     __attribute__ ((noreturn))
+     __attribute__ ((format (printf, 1, 2)));
+
+static void
+fail_io (const char *msg, ...)
+     __attribute__ ((noreturn))
+     __attribute__ ((format (printf, 1, 2)));
+
+/* Prints MSG, formatting as with printf(), and exits. */
+static void
+fail (const char *msg, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-mkfs: ");
+  va_start (args, msg);
+  vfprintf (stderr, msg, args);
+  va_end (args);
+  putc ('\n', stderr);
+  exit (EXIT_FAILURE);
+}
+
+/* Prints MSG, formatting as with printf(),
+   plus an error message based on errno,
+   and exits. */
+static void
+fail_io (const char *msg, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "pintos-mkfs: ");
+  va_start (args, msg);
+  vfprintf (stderr, msg, args);
+  va_end (args);
+
+  if (errno != 0)
+    fprintf (stderr, ": %s", strerror (errno));
+  putc ('\n', stderr);
+  exit (EXIT_FAILURE);
+}
+
+/* Returns the number of sectors needed to hold SIZE bytes. */
+static uint32_t
+bytes_to_sectors (uint32_t size)
+{
+  return (size + FS_SECTOR_SIZE - 1) / FS_SECTOR_SIZE;
+}
+
+/* The disk being formatted. */
+static const char *disk_name;
+static int disk_fd;
+static uint32_t disk_sectors;
+
+/* Free map, one bit per disk sector. */
+static uint8_t *free_map;
+static uint32_t free_map_size;
+
+/* Root directory buckets. */
+static struct fs_dir_bucket *root;
+static uint32_t root_bucket_cnt;
+
+/* Writes CNT sectors from BUF to the disk starting at SECTOR.
+   The last sector is padded with zeros if SIZE is not a multiple
+   of the sector size. */
+static void
+write_sectors (uint32_t sector, const void *buf, uint32_t size)
+{
+  static const uint8_t zeros[FS_SECTOR_SIZE];
+  off_t ofs = (off_t) sector * FS_SECTOR_SIZE;
+
+  if (pwrite (disk_fd, buf, size, ofs) != (ssize_t) size)
+    fail_io ("%s: write", disk_name);
+  if (size % FS_SECTOR_SIZE != 0)
+    {
+      uint32_t pad = FS_SECTOR_SIZE - size % FS_SECTOR_SIZE;
+      if (pwrite (disk_fd, zeros, pad, ofs + size) != (ssize_t) pad)
+        fail_io ("%s: write", disk_name);
+    }
+}
+
+/* Returns true if SECTOR is marked in the free map. */
+static bool
+free_map_test (uint32_t sector)
+{
+  return (free_map[sector / 8] >> (sector % 8)) & 1;
+}
+
+/* Marks CNT sectors starting at SECTOR in the free map. */
+static void
+free_map_mark (uint32_t sector, uint32_t cnt)
+{
+  for (; cnt > 0; sector++, cnt--)
+    free_map[sector / 8] |= 1 << (sector % 8);
+}
+
+/* Allocates CNT consecutive sectors, choosing the first free run
+   as free_map_allocate() does, and returns the first. */
+static uint32_t
+free_map_allocate (uint32_t cnt, const char *what)
+{
+  uint32_t start, run;
+
+  for (start = run = 0; start + run < disk_sectors; )
+    if (free_map_test (start + run))
+      {
+        start += run + 1;
+        run = 0;
+      }
+    else if (++run == cnt)
+      {
+        free_map_mark (start, cnt);
+        return start;
+      }
+  fail ("%s: disk full allocating %u sectors for %s",
+        disk_name, cnt, what);
+}
+
+/* Writes an inode for a file of SIZE bytes whose data is in DATA
+   to SECTOR.  Small files are stored inline.  Larger files get a
+   newly allocated run of sectors, or START if it is nonzero. */
+static void
+write_inode (uint32_t sector, const void *data, uint32_t size,
+             uint32_t start, const char *what)
+{
+  struct fs_inode inode;
+
+  memset (&inode, 0, sizeof inode);
+  inode.length = size;
+  inode.valid_length = size;
+  inode.magic = FS_INODE_MAGIC;
+  if (size <= FS_INODE_INLINE_SIZE)
+    {
+      inode.flags = FS_INODE_INLINE;
+      memcpy (inode.inline_data, data, size);
+    }
+  else
+    {
+      inode.sector_cnt = bytes_to_sectors (size);
+      inode.start = start != 0 ? start
+                               : free_map_allocate (inode.sector_cnt, what);
+      write_sectors (inode.start, data, size);
+    }
+  write_sectors (sector, &inode, sizeof inode);
+}
+
+/* Adds NAME, whose inode is at INODE_SECTOR, to the root
+   directory, as add_hashed() in filesys/directory.c does. */
+static void
+root_add (const char *name, uint32_t inode_sector)
+{
+  uint32_t home = fs_bucket_home (name, root_bucket_cnt);
+  uint32_t i;
+
+  for (i = 0; i < root_bucket_cnt; i++)
+    {
+      struct fs_dir_bucket *b = &root[(home + i) % root_bucket_cnt];
+      struct fs_dir_entry *e;
+      uint32_t slot;
+
+      if (b->used_cnt >= FS_DIR_BUCKET_ENTRIES)
+        continue;
+
+      slot = b->free_hint;
+      if (slot >= FS_DIR_BUCKET_ENTRIES || b->entries[slot].in_use)
+        for (slot = 0; b->entries[slot].in_use; slot++)
+          continue;
+
+      e = &b->entries[slot];
+      e->in_use = true;
+      strncpy (e->name, name, sizeof e->name - 1);
+      e->inode_sector = inode_sector;
+      b->used_cnt++;
+      b->free_hint = slot + 1;
+      if (i > 0)
+        root[home].overflow_cnt++;
+      return;
+    }
+  fail ("root directory full adding \"%s\"", name);
+}
+
+/* Returns true if NAME is already in the root directory. */
+static bool
+root_lookup (const char *name)
+{
+  uint32_t i, j;
+
+  for (i = 0; i < root_bucket_cnt; i++)
+    for (j = 0; j < FS_DIR_BUCKET_ENTRIES; j++)
+      if (root[i].entries[j].in_use
+          && !strcmp (root[i].entries[j].name, name))
+        return true;
+  return false;
+}
+
+/* Reads all of host file FILE_NAME into a newly allocated buffer
+   and stores its size into *SIZE. */
+static void *
+read_file (const char *file_name, uint32_t *size)
+{
+  struct stat st;
+  uint8_t *data;
+  int fd;
+
+  fd = open (file_name, O_RDONLY);
+  if (fd < 0)
+    fail_io ("%s: open", file_name);
+  if (fstat (fd, &st) < 0)
+    fail_io ("%s: stat", file_name);
+  if (!S_ISREG (st.st_mode) || st.st_size > INT32_MAX)
+    fail ("%s: not a regular file small enough for Pintos", file_name);
+
+  *size = st.st_size;
+  data = malloc (*size > 0 ? *size : 1);
+  if (data == NULL)
+    fail ("%s: out of memory", file_name);
+  if (read (fd, data, *size) != (ssize_t) *size)
+    fail_io ("%s: read", file_name);
+  close (fd);
+  return data;
+}
+
+/* Copies host file ARG, given as HOST_FILE or HOST_FILE:NAME,
+   into the root directory. */
+static void
+put_file (const char *arg)
+{
+  char host_name[4096];
+  const char *name, *colon;
+  uint32_t inode_sector, size;
+  void *data;
+
+  colon = strrchr (arg, ':');
+  if (colon != NULL && strchr (colon, '/') == NULL)
+    {
+      snprintf (host_name, sizeof host_name, "%.*s",
+                (int) (colon - arg), arg);
+      name = colon + 1;
+    }
+  else
+    {
+      snprintf (host_name, sizeof host_name, "%s", arg);
+      name = strrchr (arg, '/') != NULL ? strrchr (arg, '/') + 1 : arg;
+    }
+  if (*name == '\0' || strlen (name) > FS_NAME_MAX
+      || strchr (name, '/') != NULL)
+    fail ("\"%s\": invalid Pintos file name (at most %d characters)",
+          name, FS_NAME_MAX);
+  if (root_lookup (name))
+    fail ("\"%s\": file name given twice", name);
+
+  data = read_file (host_name, &size);
+  inode_sector = free_map_allocate (1, name);
+  write_inode (inode_sector, data, size, 0, name);
+  root_add (name, inode_sector);
+  free (data);
+}
+
+/* Formats the disk as do_format() in filesys/filesys.c does,
+   except that the free map and root directory are written last,
+   once every file has been added. */
+static void
+format (int file_cnt, char *files[])
+{
+  struct fs_journal_header *super;
+  uint32_t free_map_start = 0;
+  uint32_t root_start;
+  uint8_t *log;
+  uint32_t i;
+
+  /* Free map with the fixed sectors marked, as free_map_init(). */
+  free_map_size = fs_free_map_size (disk_sectors);
+  free_map = calloc (1, free_map_size);
+  if (free_map == NULL)
+    fail ("out of memory");
+  free_map_mark (FS_FREE_MAP_SECTOR, 1);
+  free_map_mark (FS_ROOT_DIR_SECTOR, 1);
+  free_map_mark (FS_JOURNAL_SECTOR, FS_JOURNAL_SECTORS);
+
+  /* Space for the free map file and the root directory, in the
+     order free_map_create() and dir_create() allocate it. */
+  if (free_map_size > FS_INODE_INLINE_SIZE)
+    free_map_start = free_map_allocate (bytes_to_sectors (free_map_size),
+                                        "free map");
+  root_bucket_cnt = ((FS_ROOT_DIR_ENTRIES + FS_DIR_BUCKET_ENTRIES - 1)
+                     / FS_DIR_BUCKET_ENTRIES);
+  root_start = free_map_allocate (root_bucket_cnt, "root directory");
+  root = calloc (root_bucket_cnt, sizeof *root);
+  if (root == NULL)
+    fail ("out of memory");
+  for (i = 0; i < root_bucket_cnt; i++)
+    root[i].magic = FS_DIR_BUCKET_MAGIC;
+
+  for (i = 0; i < (uint32_t) file_cnt; i++)
+    put_file (files[i]);
+
+  write_inode (FS_ROOT_DIR_SECTOR, root,
+               root_bucket_cnt * sizeof *root, root_start, "root directory");
+  write_inode (FS_FREE_MAP_SECTOR, free_map, free_map_size, free_map_start,
+               "free map");
+
+  /* Journal superblock with an empty log, as journal_init()
+     writes when formatting. */
+  log = calloc (FS_JOURNAL_SECTORS, FS_SECTOR_SIZE);
+  if (log == NULL)
+    fail ("out of memory");
+  super = (struct fs_journal_header *) log;
+  super->magic = FS_JOURNAL_MAGIC;
+  super->type = FS_JOURNAL_SUPER;
+  super->seq = 1;
+  write_sectors (FS_JOURNAL_SECTOR, log,
+                 FS_JOURNAL_SECTORS * FS_SECTOR_SIZE);
+  free (log);
+}
+
+static void
+usage (int exit_code)
+{
+  printf ("pintos-mkfs, a utility for creating Pintos file system disks\n"
+          "Usage: pintos-mkfs DISKFILE [FILE[:NAME]]...\n"
+          "where DISKFILE is an existing disk, e.g. from pintos-mkdisk,\n"
+          "  and each FILE is a host file to copy into the root directory,\n"
+          "  under NAME if given or else its base name.\n"
+          "Options:\n"
+          "  -h, --help        Display this help message.\n");
+  exit (exit_code);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct stat st;
+
+  assert (sizeof (struct fs_inode) == FS_SECTOR_SIZE);
+  assert (sizeof (struct fs_dir_bucket) == FS_SECTOR_SIZE);
+  assert (sizeof (struct fs_journal_header) == FS_SECTOR_SIZE);
+
+  if (argc > 1 && (!strcmp (argv[1], "-h") || !strcmp (argv[1], "--help")))
+    usage (EXIT_SUCCESS);
+  if (argc < 2)
+    usage (EXIT_FAILURE);
+
+  disk_name = argv[1];
+  disk_fd = open (disk_name, O_RDWR);
+  if (disk_fd < 0)
+    fail_io ("%s: open", disk_name);
+  if (fstat (disk_fd, &st) < 0)
+    fail_io ("%s: stat", disk_name);
+  if (st.st_size / FS_SECTOR_SIZE > UINT32_MAX)
+    fail ("%s: disk too large", disk_name);
+  disk_sectors = st.st_size / FS_SECTOR_SIZE;
+  if (disk_sectors < FS_FIRST_FREE_SECTOR)
+    fail ("%s: disk too small for journal", disk_name);
+  if (disk_sectors > FS_MAX_SECTORS)
+    disk_sectors = FS_MAX_SECTORS;
+
+  format (argc - 2, argv + 2);
+
+  if (close (disk_fd) < 0)
+    fail_io ("%s: close", disk_name);
+  return EXIT_SUCCESS;
+}
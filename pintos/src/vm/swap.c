@@ -1,5 +1,6 @@
 #include "vm/swap.h"
 #include <bitmap.h>
+#include <debug.h>
 #include "devices/disk.h"
 
 #define DISK_SECTOR_IN_FRAME 8
@@ -8,20 +9,28 @@
 #define SLOT_ALLOCATE true
 #define SLOT_FREE false
 
+// The swap table is a kernel bitmap with a bit per sector, so only
+// the first 1 GB of a larger swap disk is used (a 256 kB table).
+#define SWAP_MAX_SECTORS (2 * 1024 * 1024)
+
 struct bitmap *swap_table;
 struct disk *swap_disk;
 
 struct lock swap_lock;
-struct lock disk_lock;
 
 void
 swap_init (void) 
 {
 	lock_init (&swap_lock);
-	lock_init (&disk_lock);
 
 	swap_disk = disk_get(1, 1);
-	swap_table = bitmap_create(disk_size(swap_disk));
+
+	disk_sector_t size = disk_size(swap_disk);
+	if (size > SWAP_MAX_SECTORS)
+		size = SWAP_MAX_SECTORS;
+	swap_table = bitmap_create(size);
+	if (swap_table == NULL)
+		PANIC ("swap table creation failed");
 }
 
 void
@@ -36,14 +45,14 @@ swap_out (struct frame *frame)
 		return;
 	}
 	
-	int i;
 	uint8_t *kpage = frame->kpage;
 	struct page *p = frame->page;
 
-	lock_acquire(&disk_lock);
-	for (i = 0; i < DISK_SECTOR_IN_FRAME; i++)
-		disk_write (swap_disk, idx + i, kpage + i * DISK_SECTOR_SIZE);
-	lock_release(&disk_lock);
+	// The disk driver orders requests itself, so the write needs no lock
+	// and can overlap file system I/O on the other channel.
+	enum disk_user old_user = disk_set_user (DISK_USER_SWAP);
+	disk_write_multiple (swap_disk, idx, kpage, DISK_SECTOR_IN_FRAME);
+	disk_set_user (old_user);
 	
 	//printf("swap out: %x\n", (unsigned)idx);
 
@@ -58,17 +67,16 @@ swap_in (void *kpage, struct page *p)
 
 	//printf("swap in: addr %x idx %x\n", upage, idx);
 
+	enum disk_user old_user = disk_set_user (DISK_USER_SWAP);
+	disk_read_multiple (swap_disk, idx, kpage, DISK_SECTOR_IN_FRAME);
+	disk_set_user (old_user);
+
+	// Free the slot only after reading it, so that a concurrent swap_out
+	// cannot overwrite it first.
 	lock_acquire(&swap_lock);
 	bitmap_set_multiple(swap_table, idx, DISK_SECTOR_IN_FRAME, 0);
 	lock_release(&swap_lock);
 
-	int i;
-
-	lock_acquire(&disk_lock);
-	for (i = 0; i < DISK_SECTOR_IN_FRAME; i++)
-		disk_read (swap_disk, idx + i, kpage + i * DISK_SECTOR_SIZE);
-	lock_release(&disk_lock);
-
 	return true;
 }
 